@@ -1,18 +1,74 @@
 #include "controller.h"
 
+#include <stdexcept>
+
 bool Controller::Validate(std::string str) {
   return this->model_.IsCorrectExpression(str);
 }
 
+bool Controller::HasKnownNames(std::string str) {
+  return this->model_.HasKnownNames(str);
+}
+
 double Controller::Calculate(std::string str, double x) {
   return this->model_.Processing(str, x);
 }
 
+std::string Controller::CalculateExtended(std::string str, double x,
+                                          Model::Precision precision) {
+  return this->model_.ProcessingExtended(str, x, precision);
+}
+
+std::complex<double> Controller::CalculateComplex(std::string str, double x) {
+  return this->model_.ProcessingComplex(str, x);
+}
+
 std::vector<double> Controller::GetCoordinateX(double xmin, double xmax) {
   return this->model_.GetXCoordinate(xmin, xmax);
 }
 
+double Controller::GetCoordinateStep(double xmin, double xmax) {
+  return Model::GridStep(xmin, xmax);
+}
+
 std::vector<double> Controller::GetCoordinateY(std::string str, double xmin,
-                                               double xmax) {
-  return this->model_.GetYCoordinate(str, xmin, xmax);
+                                               double xmax,
+                                               Model::Accuracy accuracy) {
+  return this->model_.GetYCoordinate(str, xmin, xmax, accuracy);
+}
+
+std::vector<double> Controller::GetCoordinateYComplex(std::string str,
+                                                      double xmin, double xmax,
+                                                      Model::ComplexPart part) {
+  return this->model_.GetYCoordinateComplex(str, xmin, xmax, part);
+}
+
+void Controller::GetCoordinates(std::string str, double xmin, double xmax,
+                                Model::Accuracy accuracy, Model::Sink& sink) {
+  this->model_.GetCoordinates(str, xmin, xmax, accuracy, sink);
+}
+
+std::size_t Controller::GetCoordinates(std::string str, double xmin,
+                                       double xmax, Model::Accuracy accuracy,
+                                       double* x, double* y,
+                                       std::size_t capacity) {
+  return this->model_.GetCoordinates(str, xmin, xmax, accuracy, x, y,
+                                     capacity);
+}
+
+std::string Controller::DefineFunction(std::string definition) {
+  return this->model_.DefineFunction(definition);
+}
+
+bool Controller::RemoveFunction(std::string name) {
+  return this->model_.RemoveFunction(name);
+}
+
+std::map<std::string, std::string> Controller::GetFunctions() {
+  return this->model_.GetFunctions();
+}
+
+std::string Controller::ExportCpp(std::string str, std::string name) {
+  if (!Validate(str)) throw std::invalid_argument("Error in expression");
+  return this->model_.ExportCpp(str, name);
 }
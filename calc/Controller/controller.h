@@ -8,9 +8,28 @@ class Controller {
   Controller() {}
   ~Controller() {}
   double Calculate(std::string str, double x);
+  std::string CalculateExtended(std::string str, double x,
+                                Model::Precision precision);
+  std::complex<double> CalculateComplex(std::string str, double x);
   bool Validate(std::string str);
+  bool HasKnownNames(std::string str);
   std::vector<double> GetCoordinateX(double xmin, double xmax);
-  std::vector<double> GetCoordinateY(std::string str, double xmin, double xmax);
+  double GetCoordinateStep(double xmin, double xmax);
+  std::vector<double> GetCoordinateY(
+      std::string str, double xmin, double xmax,
+      Model::Accuracy accuracy = Model::AccuracyPlot);
+  std::vector<double> GetCoordinateYComplex(std::string str, double xmin,
+                                            double xmax,
+                                            Model::ComplexPart part);
+  void GetCoordinates(std::string str, double xmin, double xmax,
+                      Model::Accuracy accuracy, Model::Sink& sink);
+  std::size_t GetCoordinates(std::string str, double xmin, double xmax,
+                             Model::Accuracy accuracy, double* x, double* y,
+                             std::size_t capacity);
+  std::string DefineFunction(std::string definition);
+  bool RemoveFunction(std::string name);
+  std::map<std::string, std::string> GetFunctions();
+  std::string ExportCpp(std::string str, std::string name);
 
  private:
   Model model_;
@@ -0,0 +1,535 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include "jit.h"
+#include "kernels.h"
+#include "model.h"
+
+// Block evaluators. The program runs one instruction at a time over
+// kBatchSize samples, so every operator is a flat loop the compiler can
+// vectorize. Registers are laid out as [depth][kBatchSize] for real mode and
+// [depth][real, imag][kBatchSize] for complex mode.
+//
+// Programs with a Shape skip the interpreter: their loops compute a whole
+// affine step or polynomial term per pass. These must round after every
+// operation like the interpreter does, so contraction into fused
+// multiply-adds is off for this file.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace {
+
+using Complex = std::complex<double>;
+
+void CheckDivisor(const double* value, std::size_t size) {
+  bool zero = false;
+  for (std::size_t i = 0; i < size; i++) zero |= value[i] == 0;
+  if (zero) throw std::invalid_argument("can't divide by zero");
+}
+
+void CheckRange(const double* value, std::size_t size) {
+  bool outside = false;
+  for (std::size_t i = 0; i < size; i++)
+    outside |= value[i] > 1 || value[i] < -1;
+  if (outside)
+    throw std::invalid_argument(
+        "value in asin or acos must be in range[-1; 1]");
+}
+
+void CheckSqrt(const double* value, std::size_t size) {
+  bool negative = false;
+  for (std::size_t i = 0; i < size; i++) negative |= value[i] < 0;
+  if (negative) throw std::invalid_argument("negative in sqrt");
+}
+
+template <typename Function>
+void Map(double* value, std::size_t size, Function function) {
+  for (std::size_t i = 0; i < size; i++) value[i] = function(value[i]);
+}
+
+void CalculateBinarnBatch(Model::Operation operation, double* second,
+                          const double* first, std::size_t size) {
+  if (operation == Model::Add)
+    for (std::size_t i = 0; i < size; i++) second[i] += first[i];
+  if (operation == Model::Sub)
+    for (std::size_t i = 0; i < size; i++) second[i] -= first[i];
+  if (operation == Model::Mult)
+    for (std::size_t i = 0; i < size; i++) second[i] *= first[i];
+  if (operation == Model::Div) {
+    CheckDivisor(first, size);
+    for (std::size_t i = 0; i < size; i++) second[i] /= first[i];
+  }
+  if (operation == Model::Mod)
+    for (std::size_t i = 0; i < size; i++)
+      second[i] = std::fmod(second[i], first[i]);
+  if (operation == Model::Pow)
+    for (std::size_t i = 0; i < size; i++)
+      second[i] = std::pow(second[i], first[i]);
+}
+
+// The plot tier sends every function to the in-house SIMD kernels, the
+// result tier keeps libm so that batches match Processing() bit for bit.
+void CalculateUnarnBatch(Model::Operation operation, double* value,
+                         std::size_t size, Model::Accuracy accuracy) {
+  bool fast = accuracy == Model::AccuracyPlot;
+  if (operation == Model::Ln) {
+    if (fast)
+      kernels::Ln(value, size);
+    else
+      Map(value, size, [](double v) { return std::log(v); });
+  }
+  if (operation == Model::Log) {
+    if (fast)
+      kernels::Log(value, size);
+    else
+      Map(value, size, [](double v) { return std::log10(v); });
+  }
+  if (operation == Model::Sin) {
+    if (fast)
+      kernels::Sin(value, size);
+    else
+      Map(value, size, [](double v) { return std::sin(v); });
+  }
+  if (operation == Model::Cos) {
+    if (fast)
+      kernels::Cos(value, size);
+    else
+      Map(value, size, [](double v) { return std::cos(v); });
+  }
+  if (operation == Model::Tan) {
+    if (fast)
+      kernels::Tan(value, size);
+    else
+      Map(value, size, [](double v) { return std::tan(v); });
+  }
+  if (operation == Model::Asin) {
+    CheckRange(value, size);
+    if (fast)
+      kernels::Asin(value, size);
+    else
+      Map(value, size, [](double v) { return std::asin(v); });
+  }
+  if (operation == Model::Acos) {
+    CheckRange(value, size);
+    if (fast)
+      kernels::Acos(value, size);
+    else
+      Map(value, size, [](double v) { return std::acos(v); });
+  }
+  if (operation == Model::Atan) {
+    if (fast)
+      kernels::Atan(value, size);
+    else
+      Map(value, size, [](double v) { return std::atan(v); });
+  }
+  if (operation == Model::Sqrt) {
+    CheckSqrt(value, size);
+    kernels::Sqrt(value, size);
+  }
+  if (operation == Model::Root) kernels::Sqrt(value, size);
+  if (operation == Model::UnarnMinus)
+    for (std::size_t i = 0; i < size; i++) value[i] = -value[i];
+}
+
+// Plots get multiply chains, with their own loops for the common exponents
+// so that they vectorize. The result tier keeps std::pow, which is correctly
+// rounded where a chain of n multiplications is not.
+void PowIntBatch(double* value, std::size_t size, int exponent,
+                 Model::Accuracy accuracy) {
+  if (accuracy == Model::AccuracyResult)
+    for (std::size_t i = 0; i < size; i++)
+      value[i] = std::pow(value[i], exponent);
+  else if (exponent == 2)
+    for (std::size_t i = 0; i < size; i++) value[i] *= value[i];
+  else if (exponent == 3)
+    for (std::size_t i = 0; i < size; i++)
+      value[i] = value[i] * value[i] * value[i];
+  else if (exponent == -1)
+    for (std::size_t i = 0; i < size; i++) value[i] = 1 / value[i];
+  else
+    Map(value, size,
+        [exponent](double v) { return numeric::powi(v, exponent); });
+}
+
+// Leaves sin of value in sine and cos in cosine; value is one of the two.
+void SinCosBatch(const double* value, double* sine, double* cosine,
+                 std::size_t size, Model::Accuracy accuracy) {
+  if (value == cosine) std::swap_ranges(cosine, cosine + size, sine);
+  if (accuracy == Model::AccuracyPlot) {
+    kernels::SinCos(sine, cosine, size);
+  } else {
+    for (std::size_t i = 0; i < size; i++) {
+      double v = sine[i];
+      sine[i] = std::sin(v);
+      cosine[i] = std::cos(v);
+    }
+  }
+}
+
+template <typename Function>
+void MapComplex(double* real, double* imag, std::size_t size,
+                Function function) {
+  for (std::size_t i = 0; i < size; i++) {
+    Complex res = function(Complex(real[i], imag[i]));
+    real[i] = res.real();
+    imag[i] = res.imag();
+  }
+}
+
+// Arithmetic stays split into real and imaginary planes; only pow and the
+// transcendental functions go through std::complex per sample.
+void CalculateComplexBinarn(Model::Operation operation, double* left_re,
+                            double* left_im, const double* right_re,
+                            const double* right_im, std::size_t size) {
+  if (operation == Model::Add)
+    for (std::size_t i = 0; i < size; i++) {
+      left_re[i] += right_re[i];
+      left_im[i] += right_im[i];
+    }
+  if (operation == Model::Sub)
+    for (std::size_t i = 0; i < size; i++) {
+      left_re[i] -= right_re[i];
+      left_im[i] -= right_im[i];
+    }
+  if (operation == Model::Mult)
+    for (std::size_t i = 0; i < size; i++) {
+      double re = left_re[i] * right_re[i] - left_im[i] * right_im[i];
+      double im = left_re[i] * right_im[i] + left_im[i] * right_re[i];
+      left_re[i] = re;
+      left_im[i] = im;
+    }
+  if (operation == Model::Div) {
+    bool zero = false;
+    for (std::size_t i = 0; i < size; i++)
+      zero |= right_re[i] == 0 && right_im[i] == 0;
+    if (zero) throw std::invalid_argument("can't divide by zero");
+    for (std::size_t i = 0; i < size; i++) {
+      double norm = right_re[i] * right_re[i] + right_im[i] * right_im[i];
+      double re = left_re[i] * right_re[i] + left_im[i] * right_im[i];
+      double im = left_im[i] * right_re[i] - left_re[i] * right_im[i];
+      left_re[i] = re / norm;
+      left_im[i] = im / norm;
+    }
+  }
+  if (operation == Model::Mod) {
+    bool complex = false;
+    for (std::size_t i = 0; i < size; i++)
+      complex |= left_im[i] != 0 || right_im[i] != 0;
+    if (complex) throw std::invalid_argument("mod needs real operands");
+    for (std::size_t i = 0; i < size; i++)
+      left_re[i] = std::fmod(left_re[i], right_re[i]);
+  }
+  if (operation == Model::Pow)
+    for (std::size_t i = 0; i < size; i++) {
+      Complex base(left_re[i], left_im[i]);
+      Complex exponent(right_re[i], right_im[i]);
+      Complex res;
+      if (base.imag() == 0 && exponent.imag() == 0 &&
+          (base.real() > 0 || exponent.real() == std::floor(exponent.real())))
+        res = std::pow(base.real(), exponent.real());
+      else if (base == 0.0)
+        res = exponent.real() > 0 ? 0.0 : HUGE_VAL;
+      else
+        res = std::exp(exponent * std::log(base));
+      left_re[i] = res.real();
+      left_im[i] = res.imag();
+    }
+}
+
+void CalculateComplexUnarn(Model::Operation operation, double* real,
+                           double* imag, std::size_t size) {
+  if (operation == Model::Ln)
+    MapComplex(real, imag, size, [](Complex z) { return std::log(z); });
+  if (operation == Model::Log)
+    MapComplex(real, imag, size, [](Complex z) { return std::log10(z); });
+  if (operation == Model::Sin)
+    MapComplex(real, imag, size, [](Complex z) { return std::sin(z); });
+  if (operation == Model::Cos)
+    MapComplex(real, imag, size, [](Complex z) { return std::cos(z); });
+  if (operation == Model::Tan)
+    MapComplex(real, imag, size, [](Complex z) { return std::tan(z); });
+  if (operation == Model::Asin)
+    MapComplex(real, imag, size, [](Complex z) { return std::asin(z); });
+  if (operation == Model::Acos)
+    MapComplex(real, imag, size, [](Complex z) { return std::acos(z); });
+  if (operation == Model::Atan)
+    MapComplex(real, imag, size, [](Complex z) { return std::atan(z); });
+  if (operation == Model::Sqrt || operation == Model::Root)
+    MapComplex(real, imag, size, [](Complex z) { return std::sqrt(z); });
+  if (operation == Model::UnarnMinus)
+    for (std::size_t i = 0; i < size; i++) {
+      real[i] = -real[i];
+      imag[i] = 0 - imag[i];
+    }
+}
+
+// value = value * a + b or value / a + b.
+template <std::size_t kSize>
+void AffineBatch(const Model::Affine& affine, double* value) {
+  double a = affine.a;
+  double b = affine.b;
+  if (affine.divide)
+    for (std::size_t i = 0; i < kSize; i++) value[i] = value[i] / a + b;
+  else if (a != 1 || b != 0 || !std::signbit(b))
+    for (std::size_t i = 0; i < kSize; i++) value[i] = value[i] * a + b;
+}
+
+// y = term, or y += term when it is not the first one.
+template <std::size_t kSize, typename Power>
+void AddMonomial(const Model::Monomial& term, bool first, const double* x,
+                 double* y, Power power) {
+  double c = term.coefficient;
+  if (first && term.divide)
+    for (std::size_t i = 0; i < kSize; i++) y[i] = power(x[i]) / c;
+  if (first && !term.divide)
+    for (std::size_t i = 0; i < kSize; i++) y[i] = power(x[i]) * c;
+  if (!first && term.divide)
+    for (std::size_t i = 0; i < kSize; i++) y[i] += power(x[i]) / c;
+  if (!first && !term.divide)
+    for (std::size_t i = 0; i < kSize; i++) y[i] += power(x[i]) * c;
+}
+
+// Powers are those of PowIntBatch, sample by sample.
+template <std::size_t kSize>
+void MonomialBatch(const Model::Monomial& term, bool first, const double* x,
+                   double* y, Model::Accuracy accuracy) {
+  int n = term.power;
+  if (term.base == Model::Number)
+    AddMonomial<kSize>(term, first, x, y, [](double) { return 1.0; });
+  else if (term.base == Model::Variable)
+    AddMonomial<kSize>(term, first, x, y, [](double v) { return v; });
+  else if (accuracy == Model::AccuracyResult)
+    AddMonomial<kSize>(term, first, x, y,
+                       [n](double v) { return std::pow(v, n); });
+  else if (n == 2)
+    AddMonomial<kSize>(term, first, x, y, [](double v) { return v * v; });
+  else if (n == 3)
+    AddMonomial<kSize>(term, first, x, y,
+                       [](double v) { return v * v * v; });
+  else if (n == -1)
+    AddMonomial<kSize>(term, first, x, y, [](double v) { return 1 / v; });
+  else
+    AddMonomial<kSize>(term, first, x, y,
+                       [n](double v) { return numeric::powi(v, n); });
+}
+
+// Estrin's scheme: the pairs c[2j] + c[2j+1] * x summed by Horner's scheme
+// in x^2. That is half the passes over the block that Horner's scheme in x
+// takes, and the two products of a pass do not wait for each other. The
+// first pass also squares x and takes the leading coefficient of an even
+// degree.
+template <std::size_t kSize>
+void PolynomialBatch(const std::vector<double>& c, const double* x,
+                     double* y) {
+  if (c.size() == 1) {
+    std::fill(y, y + kSize, c[0]);
+    return;
+  }
+  std::size_t j = c.size() / 2 - 1;
+  double a = c[2 * j];
+  double b = c[2 * j + 1];
+  double lead = c.back();
+  double square[kSize];
+  if (c.size() % 2 == 1)
+    for (std::size_t i = 0; i < kSize; i++) {
+      square[i] = x[i] * x[i];
+      y[i] = lead * square[i] + (a + b * x[i]);
+    }
+  else
+    for (std::size_t i = 0; i < kSize; i++) {
+      square[i] = x[i] * x[i];
+      y[i] = a + b * x[i];
+    }
+  while (j-- > 0) {
+    a = c[2 * j];
+    b = c[2 * j + 1];
+    for (std::size_t i = 0; i < kSize; i++)
+      y[i] = y[i] * square[i] + (a + b * x[i]);
+  }
+}
+
+bool SameInstruction(const Model::Instruction& a,
+                     const Model::Instruction& b) {
+  return a.operation == b.operation && a.slot == b.slot &&
+         std::memcmp(&a.value, &b.value, sizeof(double)) == 0 &&
+         std::memcmp(&a.low, &b.low, sizeof(double)) == 0;
+}
+
+}  // namespace
+
+// Bit for bit, so that -0.0 and NaN constants count too.
+bool Model::SameCode(const std::vector<Instruction>& a,
+                     const std::vector<Instruction>& b) {
+  return std::equal(a.begin(), a.end(), b.begin(), b.end(), SameInstruction);
+}
+
+// Runs program as native code. Building it costs about as much as
+// interpreting kJitMinCount samples, so that is done for large batches or
+// when the same program comes back, as it does when a graph is redrawn.
+// Returns false if there is no native code for program or a sample needs one
+// of the errors only the interpreter reports.
+bool Model::ExecuteNative(const Program& program, const double* x, double* y,
+                          std::size_t count) {
+  bool same = SameCode(program.code, native_code_);
+  if (!same) {
+    native_.reset();
+    native_code_ = program.code;
+  }
+  if (!native_ && (same || count >= kJitMinCount))
+    native_ =
+        std::make_shared<jit::Function>(jit::Compile(program, kBatchSize));
+  if (!native_ || !*native_) return false;
+
+  double tail[kBatchSize];
+  for (std::size_t begin = 0; begin < count; begin += kBatchSize) {
+    std::size_t size = std::min(kBatchSize, count - begin);
+    std::size_t lanes = (size + jit::kLanes - 1) / jit::kLanes * jit::kLanes;
+    const double* block = x + begin;
+    if (lanes != size) {
+      std::copy(block, block + size, tail);
+      std::fill(tail + size, tail + lanes, block[size - 1]);
+      block = tail;
+    }
+    if (!native_->Run(block, batch_.data(), lanes)) return false;
+    std::copy(batch_.data(), batch_.data() + size, y + begin);
+  }
+  return true;
+}
+
+// Block by block on two arrays that stay in L1, like the kernels do: the
+// last block is padded with its last sample, so every loop has the fixed
+// trip count of kBatchSize that lets -O2 vectorize it.
+void Model::ExecuteShape(const Shape& shape, const double* x, double* y,
+                         std::size_t count, Accuracy accuracy) {
+  alignas(64) double arg[kBatchSize];
+  alignas(64) double res[kBatchSize];
+
+  for (std::size_t begin = 0; begin < count; begin += kBatchSize) {
+    std::size_t size = std::min(kBatchSize, count - begin);
+    std::copy(x + begin, x + begin + size, arg);
+    std::fill(arg + size, arg + kBatchSize, arg[size - 1]);
+    if (shape.function == Add && accuracy == AccuracyPlot &&
+        !shape.coefficients.empty()) {
+      PolynomialBatch<kBatchSize>(shape.coefficients, arg, res);
+    } else if (shape.function == Add) {
+      for (std::size_t k = 0; k < shape.terms.size(); k++)
+        MonomialBatch<kBatchSize>(shape.terms[k], k == 0, arg, res, accuracy);
+    } else {
+      std::copy(arg, arg + kBatchSize, res);
+      AffineBatch<kBatchSize>(shape.inner, res);
+      if (shape.function == Pow) {
+        double base = shape.base;
+        Map(res, kBatchSize, [base](double v) { return std::pow(base, v); });
+      } else if (shape.function != Variable) {
+        CalculateUnarnBatch(shape.function, res, kBatchSize, accuracy);
+      }
+      AffineBatch<kBatchSize>(shape.outer, res);
+    }
+    std::copy(res, res + size, y + begin);
+  }
+}
+
+void Model::ExecuteBatch(const Program& program, const double* x, double* y,
+                         std::size_t count, Accuracy accuracy) {
+  batch_.resize((program.depth + program.slots) * kBatchSize);
+  double* slots = batch_.data() + program.depth * kBatchSize;
+  if (accuracy == AccuracyPlot &&
+      (ExecuteProxy(program.proxy, x, y, count) ||
+       ExecuteNative(program, x, y, count)))
+    return;
+  if (program.shape.function != None) {
+    ExecuteShape(program.shape, x, y, count, accuracy);
+    return;
+  }
+
+  for (std::size_t begin = 0; begin < count; begin += kBatchSize) {
+    std::size_t size = std::min(kBatchSize, count - begin);
+    double* top = batch_.data() - kBatchSize;
+    for (const Instruction& instruction : program.code) {
+      double* slot = slots + instruction.slot * kBatchSize;
+      if (instruction.operation == Number) {
+        top += kBatchSize;
+        std::fill(top, top + size, instruction.value);
+      } else if (instruction.operation == Variable) {
+        top += kBatchSize;
+        std::copy(x + begin, x + begin + size, top);
+      } else if (instruction.operation == Load) {
+        top += kBatchSize;
+        std::copy(slot, slot + size, top);
+      } else if (IsUnarnOrBinarn(instruction.operation) == 2) {
+        top -= kBatchSize;
+        CalculateBinarnBatch(instruction.operation, top, top + kBatchSize,
+                             size);
+      } else if (instruction.operation == PowInt) {
+        PowIntBatch(top, size, static_cast<int>(instruction.value), accuracy);
+      } else if (instruction.operation == SinCos) {
+        SinCosBatch(top, top, slot, size, accuracy);
+      } else if (instruction.operation == CosSin) {
+        SinCosBatch(top, slot, top, size, accuracy);
+      } else {
+        CalculateUnarnBatch(instruction.operation, top, size, accuracy);
+      }
+    }
+    std::copy(top, top + size, y + begin);
+  }
+}
+
+void Model::ExecuteComplexBatch(const Program& program, const double* x,
+                                double* real, double* imag,
+                                std::size_t count) {
+  const std::size_t stride = 2 * kBatchSize;
+  batch_.resize((program.depth + program.slots) * stride);
+  double* slots = batch_.data() + program.depth * stride;
+
+  for (std::size_t begin = 0; begin < count; begin += kBatchSize) {
+    std::size_t size = std::min(kBatchSize, count - begin);
+    double* top = batch_.data() - stride;
+    for (const Instruction& instruction : program.code) {
+      double* slot = slots + instruction.slot * stride;
+      if (instruction.operation == Number) {
+        top += stride;
+        std::fill(top, top + size, instruction.value);
+        std::fill(top + kBatchSize, top + kBatchSize + size, 0.0);
+      } else if (instruction.operation == Variable) {
+        top += stride;
+        std::copy(x + begin, x + begin + size, top);
+        std::fill(top + kBatchSize, top + kBatchSize + size, 0.0);
+      } else if (instruction.operation == Load) {
+        top += stride;
+        std::copy(slot, slot + stride, top);
+      } else if (IsUnarnOrBinarn(instruction.operation) == 2) {
+        top -= stride;
+        CalculateComplexBinarn(instruction.operation, top, top + kBatchSize,
+                               top + stride, top + stride + kBatchSize, size);
+      } else if (instruction.operation == PowInt) {
+        int exponent = static_cast<int>(instruction.value);
+        MapComplex(top, top + kBatchSize, size, [exponent](Complex z) {
+          return z.imag() == 0 ? Complex(std::pow(z.real(), exponent))
+                               : numeric::powi(z, exponent);
+        });
+      } else if (instruction.operation == SinCos ||
+                 instruction.operation == CosSin) {
+        bool sine = instruction.operation == SinCos;
+        for (std::size_t i = 0; i < size; i++) {
+          Complex z(top[i], top[kBatchSize + i]);
+          Complex kept = sine ? std::sin(z) : std::cos(z);
+          Complex other = sine ? std::cos(z) : std::sin(z);
+          top[i] = kept.real();
+          top[kBatchSize + i] = kept.imag();
+          slot[i] = other.real();
+          slot[kBatchSize + i] = other.imag();
+        }
+      } else {
+        CalculateComplexUnarn(instruction.operation, top, top + kBatchSize,
+                              size);
+      }
+    }
+    std::copy(top, top + size, real + begin);
+    std::copy(top + kBatchSize, top + kBatchSize + size, imag + begin);
+  }
+}
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <clocale>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+#include "model.h"
+
+// C++ source for a compiled program. The generated code is the program
+// written out as straight-line assignments, one variable per register, and
+// calls the same standard library functions as Run<double>.
+
+namespace {
+
+// A double literal that reads back as value, whatever the locale.
+std::string Literal(double value) {
+  if (std::isnan(value)) return "std::nan(\"\")";
+  if (std::isinf(value)) return value > 0 ? "HUGE_VAL" : "-HUGE_VAL";
+  char buffer[32];
+#ifdef __cpp_lib_to_chars
+  std::string res(buffer,
+                  std::to_chars(buffer, buffer + sizeof(buffer), value).ptr);
+#else
+  std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+  std::string res = buffer;
+  char point = std::localeconv()->decimal_point[0];
+  if (point != '.' && point != '\0')
+    std::replace(res.begin(), res.end(), point, '.');
+#endif
+  if (res.find_first_of(".e") == std::string::npos) res += ".0";
+  return res;
+}
+
+// Keywords and alternative tokens of C++20, and main.
+const char* const kKeywords[] = {
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand", "bitor",
+    "bool", "break", "case", "catch", "char", "char8_t", "char16_t", "char32_t",
+    "class", "compl", "concept", "const", "consteval", "constexpr", "constinit",
+    "const_cast", "continue", "co_await", "co_return", "co_yield", "decltype",
+    "default", "delete", "do", "double", "dynamic_cast", "else", "enum",
+    "explicit", "export", "extern", "false", "float", "for", "friend", "goto",
+    "if", "inline", "int", "long", "main", "mutable", "namespace", "new",
+    "noexcept", "not", "not_eq", "nullptr", "operator", "or", "or_eq",
+    "private", "protected", "public", "register", "reinterpret_cast",
+    "requires", "return", "short", "signed", "sizeof", "static",
+    "static_assert", "static_cast", "struct", "switch", "template", "this",
+    "thread_local", "throw", "true", "try", "typedef", "typeid", "typename",
+    "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t",
+    "while", "xor", "xor_eq"};
+
+// A name the generated header can use for its functions: an identifier
+// that is not a keyword, not reserved to the implementation at global
+// scope (a double underscore or a leading one) and not one of the header's
+// own names: x, y, i, count, std and the registers r<n> and slots s<n>.
+bool IsIdentifier(const std::string& name) {
+  bool res = !name.empty() && !std::isdigit(name[0]);
+  for (char c : name) res = res && (std::isalnum(c) || c == '_');
+  if (!res) return false;
+  for (const char* keyword : kKeywords)
+    if (name == keyword) return false;
+  if (name.find("__") != std::string::npos || name[0] == '_') return false;
+  if (name == "x" || name == "y" || name == "i" || name == "count" ||
+      name == "std")
+    return false;
+  if ((name[0] == 'r' || name[0] == 's') && name.size() > 1 &&
+      std::all_of(name.begin() + 1, name.end(),
+                  [](char c) { return std::isdigit(c); }))
+    return false;
+  return true;
+}
+
+}  // namespace
+
+// Writes a header with no dependencies beyond the standard library:
+// name(x) evaluates the expression like Processing, errors included, and
+// name(x, y, count) fills y[i] = name(x[i]). With C++20 there is also an
+// overload for std::span.
+std::string Model::ExportCpp(std::string expression, std::string name) {
+  if (!IsIdentifier(name)) throw std::invalid_argument("incorrect name");
+  Program program = Compile(expression);
+  std::string guard = name + "_H";
+  for (char& c : guard) c = static_cast<char>(std::toupper(c));
+  auto r = [](std::size_t index) { return "r" + std::to_string(index); };
+  auto s = [](std::size_t index) { return "s" + std::to_string(index); };
+  std::ostringstream out;
+
+  out << "// " << expression << "\n"
+      << "// Exported from EngineeringCalculator. Matches its results bit for\n"
+      << "// bit when built with -ffp-contract=off and without -ffast-math.\n"
+      << "#ifndef " << guard << "\n#define " << guard << "\n\n"
+      << "#include <cmath>\n#include <cstddef>\n#include <stdexcept>\n"
+      << "#if __cplusplus >= 202002L\n#include <span>\n#endif\n\n"
+      << "inline double " << name << "(double x) {\n";
+  if (program.depth > 0) {
+    out << "  double " << r(0);
+    for (std::size_t i = 1; i < program.depth; i++) out << ", " << r(i);
+    for (std::size_t i = 0; i < program.slots; i++) out << ", " << s(i);
+    out << ";\n";
+  }
+
+  std::size_t top = 0;
+  for (const Instruction& instruction : program.code) {
+    Operation operation = instruction.operation;
+    std::string slot = s(instruction.slot);
+    if (operation == Number || operation == Variable || operation == Load) {
+      out << "  " << r(top++) << " = "
+          << (operation == Number     ? Literal(instruction.value)
+              : operation == Variable ? "x"
+                                      : slot)
+          << ";\n";
+      continue;
+    }
+    std::string value = r(top - 1);
+    if (IsUnarnOrBinarn(operation) == 2) {
+      std::string left = r(top - 2);
+      if (operation == Div)
+        out << "  if (" << value << " == 0)\n"
+            << "    throw std::invalid_argument(\"can't divide by zero\");\n";
+      out << "  " << left << " = ";
+      if (operation == Add) out << left << " + " << value;
+      if (operation == Sub) out << left << " - " << value;
+      if (operation == Mult) out << left << " * " << value;
+      if (operation == Div) out << left << " / " << value;
+      if (operation == Mod) out << "std::fmod(" << left << ", " << value << ")";
+      if (operation == Pow) out << "std::pow(" << left << ", " << value << ")";
+      out << ";\n";
+      top--;
+      continue;
+    }
+    if (operation == Asin || operation == Acos)
+      out << "  if (" << value << " > 1 || " << value << " < -1)\n"
+          << "    throw std::invalid_argument(\n"
+          << "        \"value in asin or acos must be in range[-1; 1]\");\n";
+    if (operation == Sqrt)
+      out << "  if (" << value << " < 0)\n"
+          << "    throw std::invalid_argument(\"negative in sqrt\");\n";
+    if (operation == SinCos)
+      out << "  " << slot << " = std::cos(" << value << ");\n";
+    if (operation == CosSin)
+      out << "  " << slot << " = std::sin(" << value << ");\n";
+    out << "  " << value << " = ";
+    if (operation == Ln) out << "std::log(" << value << ")";
+    if (operation == Log) out << "std::log10(" << value << ")";
+    if (operation == Sin || operation == SinCos)
+      out << "std::sin(" << value << ")";
+    if (operation == Cos || operation == CosSin)
+      out << "std::cos(" << value << ")";
+    if (operation == Tan) out << "std::tan(" << value << ")";
+    if (operation == Asin) out << "std::asin(" << value << ")";
+    if (operation == Acos) out << "std::acos(" << value << ")";
+    if (operation == Atan) out << "std::atan(" << value << ")";
+    if (operation == Sqrt || operation == Root)
+      out << "std::sqrt(" << value << ")";
+    if (operation == PowInt)
+      out << "std::pow(" << value << ", " << Literal(instruction.value) << ")";
+    if (operation == UnarnMinus) out << value << " * (-1)";
+    out << ";\n";
+  }
+
+  out << "  return " << r(0) << ";\n}\n\n"
+      << "inline void " << name
+      << "(const double* x, double* y, std::size_t count) {\n"
+      << "  for (std::size_t i = 0; i < count; i++) y[i] = " << name
+      << "(x[i]);\n}\n\n"
+      << "#if __cplusplus >= 202002L\n"
+      << "inline void " << name
+      << "(std::span<const double> x, std::span<double> y) {\n"
+      << "  if (y.size() < x.size())\n"
+      << "    throw std::invalid_argument(\"output is shorter than input\");\n"
+      << "  " << name << "(x.data(), y.data(), x.size());\n}\n"
+      << "#endif\n\n"
+      << "#endif  // " << guard << "\n";
+  return out.str();
+}
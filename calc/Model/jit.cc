@@ -0,0 +1,445 @@
+#include "jit.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+#include "kernels.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+#define JIT_X86_64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef JIT_X86_64
+
+// Array functions the generated code calls where kernels.h has none.
+void Fmod(double* value, const double* divisor, std::size_t count) {
+  for (std::size_t i = 0; i < count; i++)
+    value[i] = std::fmod(value[i], divisor[i]);
+}
+
+void Pow(double* value, const double* exponent, std::size_t count) {
+  for (std::size_t i = 0; i < count; i++)
+    value[i] = std::pow(value[i], exponent[i]);
+}
+
+// Leaves cos of value in value and sin in sine.
+void CosSin(double* value, double* sine, std::size_t count) {
+  std::memcpy(sine, value, count * sizeof(double));
+  kernels::SinCos(sine, value, count);
+}
+
+enum Register { kRax = 0, kRbx = 3, kRsp = 4, kR12 = 12, kR14 = 14 };
+
+// Second opcode byte of the 66 0F xx packed double instructions.
+enum Opcode : std::uint8_t {
+  kMovupdLoad = 0x10,
+  kMovupdStore = 0x11,
+  kMovapd = 0x28,
+  kMovmskpd = 0x50,
+  kSqrtpd = 0x51,
+  kOrpd = 0x56,
+  kXorpd = 0x57,
+  kAddpd = 0x58,
+  kMulpd = 0x59,
+  kSubpd = 0x5C,
+  kDivpd = 0x5E,
+  kCmppd = 0xC2
+};
+
+enum Predicate { kEqual = 0, kLess = 1 };
+
+// base + index + disp, or an entry of the constant pool when constant is set.
+struct Memory {
+  int base;
+  int index;
+  std::int32_t disp;
+  int constant;
+};
+
+// Encodes the few instructions the generator needs. Packed instructions are
+// written in SSE2 form, or as their 256-bit VEX form with avx set; both read
+// "opcode reg, rm" as reg = reg op rm.
+class Assembler {
+ public:
+  explicit Assembler(bool avx) : avx_(avx) {}
+
+  void Bytes(std::initializer_list<int> bytes) {
+    for (int byte : bytes) code_.push_back(static_cast<std::uint8_t>(byte));
+  }
+
+  void Immediate(std::uint64_t value, int size) {
+    for (int i = 0; i < size; i++) code_.push_back((value >> (8 * i)) & 0xFF);
+  }
+
+  void Packed(Opcode opcode, int reg, int rm, int predicate = -1) {
+    Prefix(opcode, reg, 0, rm);
+    Bytes({0xC0 | (reg & 7) << 3 | (rm & 7)});
+    if (predicate >= 0) Bytes({predicate});
+  }
+
+  void Packed(Opcode opcode, int reg, Memory memory, int predicate = -1) {
+    if (memory.constant >= 0) {
+      Prefix(opcode, reg, 0, 0);
+      Bytes({0x05 | (reg & 7) << 3});
+      std::size_t end = code_.size() + 4 + (predicate >= 0);
+      fixups_.push_back({code_.size(), end, memory.constant});
+      Immediate(0, 4);
+    } else {
+      Prefix(opcode, reg, memory.index < 0 ? 0 : memory.index, memory.base);
+      Bytes({0x84 | (reg & 7) << 3,
+             (memory.index < 0 ? 4 : memory.index & 7) << 3 |
+                 (memory.base & 7)});
+      Immediate(static_cast<std::uint32_t>(memory.disp), 4);
+    }
+    if (predicate >= 0) Bytes({predicate});
+  }
+
+  Memory Constant(double value) {
+    int index = 0;
+    while (index < static_cast<int>(constants_.size()) &&
+           std::memcmp(&constants_[index], &value, sizeof(double)) != 0)
+      index++;
+    if (index == static_cast<int>(constants_.size()))
+      constants_.push_back(value);
+    return {0, -1, 0, index};
+  }
+
+  // Jumps back to target while unsigned below.
+  void JumpBelow(std::size_t target) {
+    Bytes({0x0F, 0x82});
+    Immediate(static_cast<std::uint32_t>(target - (code_.size() + 4)), 4);
+  }
+
+  std::size_t Position() const { return code_.size(); }
+
+  // Appends the constant pool, each constant four times and 32-byte aligned
+  // so that any vector width can load it, and resolves its addresses.
+  std::vector<std::uint8_t> Finish() {
+    while (code_.size() % 32) code_.push_back(0xCC);
+    std::size_t pool = code_.size();
+    for (double value : constants_)
+      for (int lane = 0; lane < 4; lane++) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        Immediate(bits, 8);
+      }
+    for (const Fixup& fixup : fixups_) {
+      std::uint32_t disp =
+          static_cast<std::uint32_t>(pool + 32 * fixup.constant - fixup.end);
+      std::memcpy(&code_[fixup.at], &disp, sizeof(disp));
+    }
+    return code_;
+  }
+
+ private:
+  struct Fixup {
+    std::size_t at;
+    std::size_t end;
+    int constant;
+  };
+
+  void Prefix(Opcode opcode, int reg, int index, int base) {
+    bool r = reg >= 8, x = index >= 8, b = base >= 8;
+    bool source = opcode != kMovupdLoad && opcode != kMovupdStore &&
+                  opcode != kMovapd && opcode != kMovmskpd &&
+                  opcode != kSqrtpd;
+    if (avx_) {
+      int vvvv = source ? reg : 0;
+      Bytes({0xC4, !r << 7 | !x << 6 | !b << 5 | 0x01,
+             (~vvvv & 15) << 3 | 0x04 | 0x01});
+    } else {
+      Bytes({0x66});
+      if (r || x || b) Bytes({0x40 | r << 2 | x << 1 | b});
+      Bytes({0x0F});
+    }
+    Bytes({opcode});
+  }
+
+  bool avx_;
+  std::vector<std::uint8_t> code_;
+  std::vector<double> constants_;
+  std::vector<Fixup> fixups_;
+};
+
+// Vector registers 0-13 hold the stack entries of the same index, 14 and 15
+// are scratch. The generated function is
+//   int (const double* x, double* registers, std::size_t lanes)
+// with x in rbx, registers in r12, lanes in r15 and lanes * 8 in r13. Each
+// loop walks r14 over the block; a call to an array function closes the
+// loop after storing the entries it changed, and the next loop reloads
+// entries from memory as they are used. Error masks are or-ed into [rsp].
+class Generator {
+ public:
+  Generator(bool avx, std::size_t stride)
+      : assembler_(avx), avx_(avx), stride_(stride) {}
+
+  bool Build(const Model::Program& program) {
+    if (program.depth > kStackRegisters) return false;
+    state_.assign(program.depth, kInMemory);
+    Prologue();
+    int top = -1;
+    for (const Model::Instruction& instruction : program.code) {
+      Model::Operation operation = instruction.operation;
+      int slot = static_cast<int>(program.depth + instruction.slot);
+      if (operation == Model::Number || operation == Model::Variable ||
+          operation == Model::Load) {
+        Open();
+        top++;
+        if (operation == Model::Number)
+          assembler_.Packed(kMovapd, top,
+                            assembler_.Constant(instruction.value));
+        else if (operation == Model::Variable)
+          assembler_.Packed(kMovupdLoad, top, Memory{kRbx, kR14, 0, -1});
+        else
+          assembler_.Packed(kMovupdLoad, top, Array(slot));
+        state_[top] = kDirty;
+      } else if (operation == Model::Mod || operation == Model::Pow) {
+        Close();
+        Call(operation == Model::Mod ? reinterpret_cast<void*>(&Fmod)
+                                     : reinterpret_cast<void*>(&Pow),
+             top - 1, top);
+        top--;
+      } else if (operation == Model::Add || operation == Model::Sub ||
+                 operation == Model::Mult || operation == Model::Div) {
+        Ensure(top - 1);
+        Ensure(top);
+        if (operation == Model::Div) {
+          assembler_.Packed(kMovapd, kMask, top);
+          assembler_.Packed(kCmppd, kMask, assembler_.Constant(0), kEqual);
+          Check();
+        }
+        Opcode opcode = operation == Model::Add    ? kAddpd
+                        : operation == Model::Sub  ? kSubpd
+                        : operation == Model::Mult ? kMulpd
+                                                   : kDivpd;
+        assembler_.Packed(opcode, top - 1, top);
+        state_[top - 1] = kDirty;
+        state_[top--] = kInMemory;
+      } else if (operation == Model::UnarnMinus) {
+        Ensure(top);
+        assembler_.Packed(kXorpd, top, assembler_.Constant(-0.0));
+        state_[top] = kDirty;
+      } else if (operation == Model::Sqrt || operation == Model::Root) {
+        Ensure(top);
+        if (operation == Model::Sqrt) {
+          assembler_.Packed(kMovapd, kMask, top);
+          assembler_.Packed(kCmppd, kMask, assembler_.Constant(0), kLess);
+          Check();
+        }
+        assembler_.Packed(kSqrtpd, top, top);
+        state_[top] = kDirty;
+      } else if (operation == Model::PowInt) {
+        Ensure(top);
+        PowInt(top, static_cast<int>(instruction.value));
+        state_[top] = kDirty;
+      } else if (operation == Model::SinCos || operation == Model::CosSin) {
+        Close();
+        Call(operation == Model::SinCos
+                 ? reinterpret_cast<void*>(&kernels::SinCos)
+                 : reinterpret_cast<void*>(&CosSin),
+             top, slot);
+      } else {
+        void (*function)(double*, std::size_t) = nullptr;
+        if (operation == Model::Ln) function = &kernels::Ln;
+        if (operation == Model::Log) function = &kernels::Log;
+        if (operation == Model::Sin) function = &kernels::Sin;
+        if (operation == Model::Cos) function = &kernels::Cos;
+        if (operation == Model::Tan) function = &kernels::Tan;
+        if (operation == Model::Asin) function = &kernels::Asin;
+        if (operation == Model::Acos) function = &kernels::Acos;
+        if (operation == Model::Atan) function = &kernels::Atan;
+        if (!function) return false;
+        if (operation == Model::Asin || operation == Model::Acos) {
+          Ensure(top);
+          assembler_.Packed(kMovapd, kMask, top);
+          assembler_.Packed(kCmppd, kMask, assembler_.Constant(-1), kLess);
+          assembler_.Packed(kMovapd, kScratch, assembler_.Constant(1));
+          assembler_.Packed(kCmppd, kScratch, top, kLess);
+          assembler_.Packed(kOrpd, kMask, kScratch);
+          Check();
+        }
+        Close();
+        Call(reinterpret_cast<void*>(function), top, -1);
+      }
+    }
+    Close();
+    Epilogue();
+    return top == 0;
+  }
+
+  std::vector<std::uint8_t> Finish() { return assembler_.Finish(); }
+
+ private:
+  enum State { kInMemory, kClean, kDirty };
+
+  static const std::size_t kStackRegisters = 14;
+  static const int kScratch = 14;
+  static const int kMask = 15;
+
+  Memory Array(int index) const {
+    return {kR12, kR14, static_cast<std::int32_t>(index * stride_ * 8), -1};
+  }
+
+  void Prologue() {
+    // push rbx, r12-r15; sub rsp, 32
+    assembler_.Bytes({0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57});
+    assembler_.Bytes({0x48, 0x83, 0xEC, 0x20});
+    // mov rbx, rdi; mov r12, rsi; mov r15, rdx; mov r13, rdx; shl r13, 3
+    assembler_.Bytes({0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4, 0x49, 0x89, 0xD7});
+    assembler_.Bytes({0x49, 0x89, 0xD5, 0x49, 0xC1, 0xE5, 0x03});
+    assembler_.Packed(kXorpd, kMask, kMask);
+    assembler_.Packed(kMovupdStore, kMask, Memory{kRsp, -1, 0, -1});
+  }
+
+  void Epilogue() {
+    assembler_.Packed(kMovupdLoad, kMask, Memory{kRsp, -1, 0, -1});
+    assembler_.Packed(kMovmskpd, kRax, kMask);
+    // add rsp, 32; pop r15-r12, rbx
+    assembler_.Bytes({0x48, 0x83, 0xC4, 0x20});
+    assembler_.Bytes({0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B});
+    if (avx_) assembler_.Bytes({0xC5, 0xF8, 0x77});  // vzeroupper
+    assembler_.Bytes({0xC3});
+  }
+
+  // Starts a loop over the block unless one is open.
+  void Open() {
+    if (open_) return;
+    assembler_.Bytes({0x45, 0x31, 0xF6});  // xor r14d, r14d
+    loop_ = assembler_.Position();
+    open_ = true;
+  }
+
+  // Stores the changed entries and ends the loop.
+  void Close() {
+    if (!open_) return;
+    for (std::size_t i = 0; i < state_.size(); i++) {
+      if (state_[i] == kDirty)
+        assembler_.Packed(kMovupdStore, static_cast<int>(i),
+                          Array(static_cast<int>(i)));
+      state_[i] = kInMemory;
+    }
+    // add r14, width; cmp r14, r13; jb loop
+    assembler_.Bytes({0x49, 0x81, 0xC6});
+    assembler_.Immediate(avx_ ? 32 : 16, 4);
+    assembler_.Bytes({0x4D, 0x39, 0xEE});
+    assembler_.JumpBelow(loop_);
+    open_ = false;
+  }
+
+  void Ensure(int index) {
+    Open();
+    if (state_[index] != kInMemory) return;
+    assembler_.Packed(kMovupdLoad, index, Array(index));
+    state_[index] = kClean;
+  }
+
+  // Or-s the mask register into the error mask at [rsp].
+  void Check() {
+    assembler_.Packed(kOrpd, kMask, Memory{kRsp, -1, 0, -1});
+    assembler_.Packed(kMovupdStore, kMask, Memory{kRsp, -1, 0, -1});
+  }
+
+  // Same multiplications in the same order as numeric::powi.
+  void PowInt(int index, int exponent) {
+    bool first = true;
+    for (unsigned k = exponent < 0 ? -exponent : exponent; k != 0; k /= 2) {
+      if (k % 2 && first) assembler_.Packed(kMovapd, kMask, index);
+      if (k % 2 && !first) assembler_.Packed(kMulpd, kMask, index);
+      first = first && k % 2 == 0;
+      if (k > 1) assembler_.Packed(kMulpd, index, index);
+    }
+    if (exponent == 0) {
+      assembler_.Packed(kMovapd, index, assembler_.Constant(1));
+    } else if (exponent < 0) {
+      assembler_.Packed(kMovapd, kScratch, assembler_.Constant(1));
+      assembler_.Packed(kDivpd, kScratch, kMask);
+      assembler_.Packed(kMovapd, index, kScratch);
+    } else {
+      assembler_.Packed(kMovapd, index, kMask);
+    }
+  }
+
+  // Calls function(registers + first, [registers + second,] lanes).
+  void Call(void* function, int first, int second) {
+    if (avx_) assembler_.Bytes({0xC5, 0xF8, 0x77});  // vzeroupper
+    assembler_.Bytes({0x49, 0x8D, 0xBC, 0x24});      // lea rdi, [r12 + d]
+    assembler_.Immediate(first * stride_ * 8, 4);
+    if (second >= 0) {
+      assembler_.Bytes({0x49, 0x8D, 0xB4, 0x24});  // lea rsi, [r12 + d]
+      assembler_.Immediate(second * stride_ * 8, 4);
+      assembler_.Bytes({0x4C, 0x89, 0xFA});  // mov rdx, r15
+    } else {
+      assembler_.Bytes({0x4C, 0x89, 0xFE});  // mov rsi, r15
+    }
+    assembler_.Bytes({0x48, 0xB8});  // mov rax, function
+    assembler_.Immediate(reinterpret_cast<std::uintptr_t>(function), 8);
+    assembler_.Bytes({0xFF, 0xD0});  // call rax
+  }
+
+  Assembler assembler_;
+  bool avx_;
+  std::size_t stride_;
+  std::vector<State> state_;
+  bool open_ = false;
+  std::size_t loop_ = 0;
+};
+
+#endif
+
+}  // namespace
+
+namespace jit {
+
+Function::Function(Function&& other) : code_(other.code_), size_(other.size_) {
+  other.code_ = nullptr;
+}
+
+Function& Function::operator=(Function&& other) {
+  std::swap(code_, other.code_);
+  std::swap(size_, other.size_);
+  return *this;
+}
+
+Function::~Function() {
+#ifdef JIT_X86_64
+  if (code_) munmap(code_, size_);
+#endif
+}
+
+bool Function::Run(const double* x, double* registers,
+                   std::size_t lanes) const {
+  using Entry = int (*)(const double*, double*, std::size_t);
+  return reinterpret_cast<Entry>(code_)(x, registers, lanes) == 0;
+}
+
+Function Compile([[maybe_unused]] const Model::Program& program,
+                 [[maybe_unused]] std::size_t stride) {
+  Function res;
+#ifdef JIT_X86_64
+  Generator generator(__builtin_cpu_supports("avx"), stride);
+  if (!generator.Build(program)) return res;
+  std::vector<std::uint8_t> code = generator.Finish();
+  std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+  std::size_t size = (code.size() + page - 1) / page * page;
+  void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) return res;
+  std::memcpy(memory, code.data(), code.size());
+  if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+    munmap(memory, size);
+    return res;
+  }
+  res.code_ = memory;
+  res.size_ = size;
+#endif
+  return res;
+}
+
+}  // namespace jit
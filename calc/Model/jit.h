@@ -0,0 +1,53 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <cstddef>
+
+#include "model.h"
+
+// Native code for programs on the plot accuracy tier. Compile turns a
+// Model::Program into straight-line x86-64 code that keeps the evaluation
+// stack in vector registers (ymm with AVX, xmm with SSE2 otherwise) and has
+// its constants baked into the same mapping. Arithmetic, sqrt, unary minus
+// and integer powers run inline; the other functions are calls to the array
+// kernels in kernels.h between the loops. Results match ExecuteBatch on the
+// plot tier bit for bit.
+//
+// Nothing is needed at run time but mmap. On other CPUs and systems, or for
+// programs deeper than the register file, Compile returns an empty Function
+// and the caller keeps interpreting.
+namespace jit {
+
+// Block sizes passed to Function::Run must be a multiple of kLanes.
+const std::size_t kLanes = 4;
+
+class Function {
+ public:
+  Function() {}
+  Function(Function&& other);
+  Function& operator=(Function&& other);
+  Function(const Function&) = delete;
+  Function& operator=(const Function&) = delete;
+  ~Function();
+
+  explicit operator bool() const { return code_ != nullptr; }
+
+  // Evaluates lanes samples of x into registers[0..lanes), with registers
+  // laid out as in ExecuteBatch. Returns false if a sample hit one of the
+  // errors ExecuteBatch throws for (zero divisor, negative sqrt, asin or
+  // acos out of range); which one is left to the interpreter to report.
+  bool Run(const double* x, double* registers, std::size_t lanes) const;
+
+ private:
+  friend Function Compile(const Model::Program& program, std::size_t stride);
+
+  void* code_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+// stride is the length of one register array in doubles.
+Function Compile(const Model::Program& program, std::size_t stride);
+
+}  // namespace jit
+
+#endif  // JIT_H
@@ -0,0 +1,329 @@
+#include "kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Polynomials and reductions follow the Cephes double precision library
+// (S. L. Moshier), rewritten so that every branch becomes a select.
+
+namespace {
+
+const std::size_t kChunk = 64;
+
+const double kPiOver2 = 1.57079632679489661923;
+const double kPiOver4 = 7.85398163397448309616E-1;
+const double kFourOverPi = 1.27323954473516268615;
+const double kMoreBits = 6.123233995736765886130E-17;
+const double kSinCosLimit = 1e8;
+
+// Cody-Waite split of pi / 4 for argument reduction.
+const double kDP1 = 7.85398125648498535156E-1;
+const double kDP2 = 3.77489470793079817668E-8;
+const double kDP3 = 2.69515142907905952645E-15;
+
+const double kSinCoef[] = {1.58962301576546568060E-10,
+                           -2.50507477628578072866E-8,
+                           2.75573136213857245213E-6,
+                           -1.98412698295895385996E-4,
+                           8.33333333332211858878E-3,
+                           -1.66666666666666307295E-1};
+const double kCosCoef[] = {-1.13585365213876817300E-11,
+                           2.08757008419747316778E-9,
+                           -2.75573141792967388112E-7,
+                           2.48015872888517045348E-5,
+                           -1.38888888888730564116E-3,
+                           4.16666666666665929218E-2};
+
+const double kLogP[] = {1.01875663804580931796E-4, 4.97494994976747001425E-1,
+                        4.70579119878881725854E0, 1.44989225341610930846E1,
+                        1.79368678507819816313E1, 7.70838733755885391666E0};
+const double kLogQ[] = {1.0, 1.12873587189167450590E1, 4.52279145837532221105E1,
+                        8.29875266912776603211E1, 7.11544750618563894466E1,
+                        2.31251620126765340583E1};
+
+const double kAtanP[] = {-8.750608600031904122785E-1,
+                         -1.615753718733365076637E1, -7.500855792314704667340E1,
+                         -1.228866684490136173410E2,
+                         -6.485021904942025371773E1};
+const double kAtanQ[] = {1.0, 2.485846490142306297962E1,
+                         1.650270098316988542046E2, 4.328810604912902668951E2,
+                         4.853903996359136964868E2, 1.945506571482613964425E2};
+
+const double kAsinP[] = {4.253011369004428248960E-3,
+                         -6.019598008014123785661E-1, 5.444622390564711410273E0,
+                         -1.626247967210700244449E1, 1.956261983317594739197E1,
+                         -8.198089802484824371615E0};
+const double kAsinQ[] = {1.0, -1.474091372988853791896E1,
+                         7.049610280856842141659E1, -1.471791292232726029859E2,
+                         1.395105614657485689735E2, -4.918853881490881290097E1};
+const double kAsinR[] = {2.967721961301243206100E-3,
+                         -5.634242780008963776856E-1, 6.968710824104713396794E0,
+                         -2.556901049652824852289E1, 2.853665548261061424989E1};
+const double kAsinS[] = {1.0, -2.194779531642920639778E1,
+                         1.470656354026814941758E2, -3.838770957603691357202E2,
+                         3.424398657913078477438E2};
+
+template <std::size_t N>
+inline double Horner(double x, const double (&coef)[N]) {
+  double res = coef[0];
+  for (std::size_t i = 1; i < N; i++) res = res * x + coef[i];
+  return res;
+}
+
+inline std::uint64_t Bits(double value) {
+  std::uint64_t res;
+  std::memcpy(&res, &value, sizeof(res));
+  return res;
+}
+
+inline double FromBits(std::uint64_t bits) {
+  double res;
+  std::memcpy(&res, &bits, sizeof(res));
+  return res;
+}
+
+// Runs kernel over the values in chunks; values for which inside() is false
+// are recomputed with the libm fallback afterwards. Every chunk is padded to
+// kChunk so the kernel loop has a fixed trip count, which is what lets -O2
+// vectorize it. The kernel sees those values as 0.5 like the padding, since
+// some convert their argument to int, which is undefined for it.
+template <typename Kernel, typename Inside, typename Fallback>
+void Apply(double* value, std::size_t count, Kernel kernel, Inside inside,
+           Fallback fallback) {
+  alignas(64) double arg[kChunk];
+  alignas(64) double res[kChunk];
+
+  for (std::size_t begin = 0; begin < count; begin += kChunk) {
+    std::size_t size = std::min(kChunk, count - begin);
+    double* chunk = value + begin;
+    bool outside = false;
+    std::copy(chunk, chunk + size, arg);
+    std::fill(arg + size, arg + kChunk, 0.5);
+    for (std::size_t i = 0; i < kChunk; i++) outside |= !inside(arg[i]);
+    if (outside)
+      for (std::size_t i = 0; i < kChunk; i++)
+        if (!inside(arg[i])) arg[i] = 0.5;
+    for (std::size_t i = 0; i < kChunk; i++) res[i] = kernel(arg[i]);
+    if (outside)
+      for (std::size_t i = 0; i < size; i++)
+        if (!inside(chunk[i])) res[i] = fallback(chunk[i]);
+    std::copy(res, res + size, chunk);
+  }
+}
+
+// Reduces |x| to z in [-pi/4, pi/4] and returns the octant pair (0..3) that
+// picks between the sine and cosine polynomials.
+inline int Reduce(double x, double& z) {
+  double a = std::fabs(x);
+  int j = static_cast<int>(a * kFourOverPi);
+  j += j & 1;
+  double y = j;
+  z = ((a - y * kDP1) - y * kDP2) - y * kDP3;
+  return j & 7;
+}
+
+inline double SinPoly(double z, double zz) {
+  return z + z * zz * Horner(zz, kSinCoef);
+}
+
+inline double CosPoly(double zz) {
+  return 1.0 - 0.5 * zz + zz * zz * Horner(zz, kCosCoef);
+}
+
+inline double SinKernel(double x) {
+  double z;
+  int j = Reduce(x, z);
+  double zz = z * z;
+  double s = SinPoly(z, zz);
+  double c = CosPoly(zz);
+  double res = (j & 2) ? c : s;
+  bool negative = (j > 3) != (x < 0);
+  return negative ? -res : res;
+}
+
+inline double CosKernel(double x) {
+  double z;
+  int j = Reduce(x, z);
+  double zz = z * z;
+  double s = SinPoly(z, zz);
+  double c = CosPoly(zz);
+  double res = (j & 2) ? s : c;
+  bool negative = (j > 3) != ((j & 2) != 0);
+  return negative ? -res : res;
+}
+
+inline void SinCosKernel(double x, double& sine, double& cosine) {
+  double z;
+  int j = Reduce(x, z);
+  double zz = z * z;
+  double s = SinPoly(z, zz);
+  double c = CosPoly(zz);
+  double res_sin = (j & 2) ? c : s;
+  double res_cos = (j & 2) ? s : c;
+  sine = (j > 3) != (x < 0) ? -res_sin : res_sin;
+  cosine = (j > 3) != ((j & 2) != 0) ? -res_cos : res_cos;
+}
+
+inline double TanKernel(double x) {
+  double z;
+  int j = Reduce(x, z);
+  double zz = z * z;
+  double s = SinPoly(z, zz);
+  double c = CosPoly(zz);
+  double res = (j & 2) ? -c / s : s / c;
+  return x < 0 ? -res : res;
+}
+
+// log(x) = e * ln2 + log(m) with m in [sqrt(1/2), sqrt(2)).
+inline double LnKernel(double x) {
+  std::uint64_t bits = Bits(x);
+  // Biased exponent to double without an int64 conversion, which SSE2 and
+  // AVX2 cannot vectorize: 2^52 + e reinterpreted, minus 2^52.
+  double e = FromBits((bits >> 52) | 0x4330000000000000ULL) -
+             4503599627370496.0 - 1022.0;
+  double m = FromBits((bits & 0x000fffffffffffffULL) | 0x3fe0000000000000ULL);
+  bool low = m < 0.70710678118654752440;
+  double f = low ? m + m - 1.0 : m - 1.0;
+  double exponent = low ? e - 1.0 : e;
+  double z = f * f;
+  double y = f * (z * Horner(f, kLogP) / Horner(f, kLogQ));
+  y = y - exponent * 2.121944400546905827679e-4;
+  y = y - 0.5 * z;
+  return f + y + exponent * 0.693359375;
+}
+
+inline double AtanKernel(double x) {
+  double a = std::fabs(x);
+  bool big = a > 2.41421356237309504880;
+  bool middle = !big && a > 0.66;
+  double t = big ? -1.0 / a : middle ? (a - 1.0) / (a + 1.0) : a;
+  double base = big ? kPiOver2 : middle ? kPiOver4 : 0.0;
+  double more = big ? kMoreBits : middle ? 0.5 * kMoreBits : 0.0;
+  double z = t * t;
+  z = z * Horner(z, kAtanP) / Horner(z, kAtanQ);
+  double res = base + (t * z + t + more);
+  return x < 0 ? -res : res;
+}
+
+inline double AsinKernel(double x) {
+  double a = std::fabs(x);
+  bool big = a > 0.625;
+  double zz_big = 1.0 - a;
+  double p = zz_big * Horner(zz_big, kAsinR) / Horner(zz_big, kAsinS);
+  double root = std::sqrt(zz_big + zz_big);
+  double res_big = kPiOver4 - root;
+  res_big = res_big - (root * p - kMoreBits);
+  res_big = res_big + kPiOver4;
+  double zz = a * a;
+  double res_small = a * (zz * Horner(zz, kAsinP) / Horner(zz, kAsinQ)) + a;
+  double res = big ? res_big : res_small;
+  return x < 0 ? -res : res;
+}
+
+inline double AcosKernel(double x) {
+  bool low = x < -0.5;
+  bool high = x > 0.5;
+  double half = std::sqrt(0.5 * (low ? 1.0 + x : 1.0 - x));
+  double edge = 2.0 * AsinKernel(half);
+  double middle = (kPiOver4 - AsinKernel(x)) + kMoreBits + kPiOver4;
+  return low ? 3.14159265358979323846 - edge : high ? edge : middle;
+}
+
+bool InsideTrig(double x) { return std::fabs(x) <= kSinCosLimit; }
+bool InsideLog(double x) {
+  return x >= 2.2250738585072014e-308 && x <= 1.7976931348623157e308;
+}
+bool InsideUnit(double x) { return std::fabs(x) <= 1.0; }
+bool InsideAll(double x) { return !std::isnan(x); }
+
+}  // namespace
+
+namespace kernels {
+
+// sin, cos: max 1.56 ulp on random x in [-1e8, 1e8] and 1.54 * 2^-53
+// absolute everywhere there; see kernels.h for arguments near the zeros.
+void Sin(double* value, std::size_t count) {
+  Apply(value, count, SinKernel, InsideTrig,
+        [](double x) { return std::sin(x); });
+}
+
+void Cos(double* value, std::size_t count) {
+  Apply(value, count, CosKernel, InsideTrig,
+        [](double x) { return std::cos(x); });
+}
+
+// Same as Apply with two results per value.
+void SinCos(double* value, double* cosine, std::size_t count) {
+  alignas(64) double arg[kChunk];
+  alignas(64) double res_sin[kChunk];
+  alignas(64) double res_cos[kChunk];
+
+  for (std::size_t begin = 0; begin < count; begin += kChunk) {
+    std::size_t size = std::min(kChunk, count - begin);
+    bool outside = false;
+    std::copy(value + begin, value + begin + size, arg);
+    std::fill(arg + size, arg + kChunk, 0.5);
+    for (std::size_t i = 0; i < kChunk; i++) outside |= !InsideTrig(arg[i]);
+    if (outside)
+      for (std::size_t i = 0; i < kChunk; i++)
+        if (!InsideTrig(arg[i])) arg[i] = 0.5;
+    for (std::size_t i = 0; i < kChunk; i++)
+      SinCosKernel(arg[i], res_sin[i], res_cos[i]);
+    if (outside)
+      for (std::size_t i = 0; i < size; i++)
+        if (!InsideTrig(value[begin + i])) {
+          res_sin[i] = std::sin(value[begin + i]);
+          res_cos[i] = std::cos(value[begin + i]);
+        }
+    std::copy(res_sin, res_sin + size, value + begin);
+    std::copy(res_cos, res_cos + size, cosine + begin);
+  }
+}
+
+// tan: quotient of the two polynomials, max 3.41 ulp on random x in
+// [-1e8, 1e8]; not near its zeros and poles, see kernels.h.
+void Tan(double* value, std::size_t count) {
+  Apply(value, count, TanKernel, InsideTrig,
+        [](double x) { return std::tan(x); });
+}
+
+// ln: max 0.86 ulp over all normal positive doubles.
+void Ln(double* value, std::size_t count) {
+  Apply(value, count, LnKernel, InsideLog,
+        [](double x) { return std::log(x); });
+}
+
+// log10 = ln(x) * log10(e), max 1.84 ulp.
+void Log(double* value, std::size_t count) {
+  Apply(
+      value, count,
+      [](double x) { return LnKernel(x) * 0.43429448190325182765; },
+      InsideLog, [](double x) { return std::log10(x); });
+}
+
+// atan: max 0.94 ulp.
+void Atan(double* value, std::size_t count) {
+  Apply(value, count, AtanKernel, InsideAll,
+        [](double x) { return std::atan(x); });
+}
+
+// asin, acos: max 1.20 ulp on [-1, 1].
+void Asin(double* value, std::size_t count) {
+  Apply(value, count, AsinKernel, InsideUnit,
+        [](double x) { return std::asin(x); });
+}
+
+void Acos(double* value, std::size_t count) {
+  Apply(value, count, AcosKernel, InsideUnit,
+        [](double x) { return std::acos(x); });
+}
+
+void Sqrt(double* value, std::size_t count) {
+  Apply(
+      value, count, [](double x) { return std::sqrt(x); }, InsideAll,
+      [](double x) { return std::sqrt(x); });
+}
+
+}  // namespace kernels
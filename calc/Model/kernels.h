@@ -0,0 +1,50 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+
+// Array versions of the calculator functions for plotting. Each one works in
+// place on count values and is written as a branch-free polynomial per
+// element, so the compiler turns the main loop into SIMD code for whatever
+// vector width the target has (SSE2, AVX2, NEON). Values outside a kernel's
+// domain (huge arguments, zero, negative, inf, nan) are sent to libm after
+// the vector pass, so special cases behave exactly as std:: does.
+//
+// Largest errors against a long double reference over 2e6 random arguments
+// per range (the measured values are next to each kernel in kernels.cc):
+//
+//   Sin, Cos   |x| <= 1e8          1.6 ulp, and 1.7e-16 absolute
+//   Tan        |x| <= 1e8          3.4 ulp
+//   Ln         normal x > 0        0.9 ulp
+//   Log        normal x > 0        1.9 ulp
+//   Atan       all x               0.9 ulp
+//   Asin       |x| <= 1            1.2 ulp
+//   Acos       |x| <= 1            1.2 ulp
+//   Sqrt       all x               correctly rounded (hardware)
+//
+// Random arguments almost never fall near a zero of sin or cos, where the
+// ulp figures do not hold: x is reduced by multiples of pi/2 in double
+// precision, which is accurate in absolute terms only. cos(33 * pi / 2) is
+// 199 ulp off and sin(pi) 6.9, both far below 1e-16 in absolute terms; tan
+// loses the same near its zeros and poles. That is invisible in a plot, and
+// the result tier below has no such loss.
+//
+// These make up the "plot" accuracy tier. The "result" tier is libm itself
+// (<= 1 ulp in glibc and Apple libm) and is what the result line uses.
+namespace kernels {
+
+void Sin(double* value, std::size_t count);
+void Cos(double* value, std::size_t count);
+// Leaves sin in value and writes cos to cosine, with one range reduction.
+void SinCos(double* value, double* cosine, std::size_t count);
+void Tan(double* value, std::size_t count);
+void Ln(double* value, std::size_t count);
+void Log(double* value, std::size_t count);
+void Atan(double* value, std::size_t count);
+void Asin(double* value, std::size_t count);
+void Acos(double* value, std::size_t count);
+void Sqrt(double* value, std::size_t count);
+
+}  // namespace kernels
+
+#endif  // KERNELS_H
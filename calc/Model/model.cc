@@ -1,6 +1,54 @@
 #include "model.h"
 
-Model::Operation Model::get_enum_type(std::string expression, short index) {
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+// x and the built-in functions, which user functions may not be named after.
+constexpr std::string_view kReserved[] = {"x",    "ln",   "log",  "sin",
+                                          "cos",  "tan",  "sqrt", "asin",
+                                          "acos", "atan", "mod"};
+
+std::uint64_t Bits(double value) {
+  std::uint64_t res;
+  std::memcpy(&res, &value, sizeof(res));
+  return res;
+}
+
+template <typename T>
+T Constant(const Model::Instruction& instruction) {
+  if (instruction.low == 0) return T(instruction.value);
+  return T(instruction.value) + T(instruction.low);
+}
+
+template <>
+double Constant<double>(const Model::Instruction& instruction) {
+  return instruction.value;
+}
+
+class VectorSink : public Model::Sink {
+ public:
+  explicit VectorSink(std::vector<double>& y) : y_(y) {}
+  void Resize(std::size_t count) override { y_.resize(count); }
+  void Write(std::size_t index, const double*, const double* y,
+             std::size_t count) override {
+    std::copy(y, y + count, y_.begin() + index);
+  }
+
+ private:
+  std::vector<double>& y_;
+};
+
+}  // namespace
+
+Model::Operation Model::get_enum_type(const std::string& expression,
+                                      std::size_t index) {
   Operation res = None;
   if (expression[index] == '(') res = OpenBracket;
   if (expression[index] == ')') res = CloseBracket;
@@ -20,6 +68,7 @@ Model::Operation Model::get_enum_type(std::string expression, short index) {
   if (expression[index] == 'a' && expression[index + 1] == 'c') res = Acos;
   if (expression[index] == 'a' && expression[index + 1] == 't') res = Atan;
   if (expression[index] == '~') res = UnarnMinus;
+  if (!get_symbol(expression, index).empty()) res = Call;
   return res;
 }
 
@@ -35,7 +84,7 @@ short Model::get_length(Operation operation) {
   return res;
 }
 
-short Model::get_priority(std::string expression, short index) {
+short Model::get_priority(const std::string& expression, std::size_t index) {
   short priority;
   if (expression[index] == '(' || expression[index] == ')') priority = 0;
   if (expression[index] == '+' || expression[index] == '-') priority = 1;
@@ -56,13 +105,32 @@ short Model::get_priority(std::string expression, short index) {
        expression[index + 1] == 't'))
     priority = 4;
   if (expression[index] == '~') priority = 5;
+  if (!get_symbol(expression, index).empty()) priority = 4;
   return priority;
 }
 
-Model::Leksema Model::AddElement(std::string expression, short index) {
+// Returns the name of the user function called at index (the name must be
+// followed by an open bracket), or an empty string. The longest name wins so
+// that "gg(" is not taken for "g".
+std::string Model::get_symbol(const std::string& expression,
+                              std::size_t index) {
+  std::string res;
+  for (const auto& function : functions_) {
+    const std::string& name = function.first;
+    if (name.length() > res.length() &&
+        expression.compare(index, name.length(), name) == 0 &&
+        expression[index + name.length()] == '(')
+      res = name;
+  }
+  return res;
+}
+
+Model::Leksema Model::AddElement(const std::string& expression,
+                                 std::size_t index) {
   Leksema element;
   element.operation = get_enum_type(expression, index);
   element.priority = get_priority(expression, index);
+  element.symbol = get_symbol(expression, index);
   return element;
 }
 
@@ -74,129 +142,670 @@ short Model::IsUnarnOrBinarn(Operation operation) {
   if (operation == Ln || operation == Log || operation == Sin ||
       operation == Cos || operation == Tan || operation == Asin ||
       operation == Acos || operation == Atan || operation == Sqrt ||
-      operation == UnarnMinus)
+      operation == UnarnMinus || operation == Root)
     res = 1;
   return res;
 }
 
-void Model::CalculateBinarn(std::stack<double>& Stack_digits,
-                            std::stack<Leksema>& Stack_operators) {
-  double first_value = Stack_digits.top();
-  Stack_digits.pop();
-  double second_value = Stack_digits.top();
-  Stack_digits.pop();
-  if (Stack_operators.top().operation == Add)
-    Stack_digits.push(second_value + first_value);
-  if (Stack_operators.top().operation == Sub)
-    Stack_digits.push(second_value - first_value);
-  if (Stack_operators.top().operation == Mult)
-    Stack_digits.push(second_value * first_value);
-  if (Stack_operators.top().operation == Div) {
+// Shared by constant folding and by every evaluator precision. The double
+// instantiation calls std:: directly, so it is exactly the old code path.
+template <typename T>
+T Model::CalculateBinarn(Operation operation, T second_value, T first_value) {
+  T res = 0;
+  if (operation == Add) res = second_value + first_value;
+  if (operation == Sub) res = second_value - first_value;
+  if (operation == Mult) res = second_value * first_value;
+  if (operation == Div) {
     if (first_value == 0) throw std::invalid_argument("can't divide by zero");
-    Stack_digits.push(second_value / first_value);
+    res = second_value / first_value;
   }
-  if (Stack_operators.top().operation == Mod)
-    Stack_digits.push(std::fmod(second_value, first_value));
-  if (Stack_operators.top().operation == Pow)
-    Stack_digits.push(std::pow(second_value, first_value));
-  Stack_operators.pop();
+  if (operation == Mod) res = numeric::fmod(second_value, first_value);
+  if (operation == Pow) res = numeric::pow(second_value, first_value);
+  return res;
 }
 
-void Model::CalculateUnarn(std::stack<double>& Stack_digits,
-                           std::stack<Leksema>& Stack_operators) {
-  double value = Stack_digits.top();
-  Stack_digits.pop();
-  if (Stack_operators.top().operation == Ln) Stack_digits.push(std::log(value));
-  if (Stack_operators.top().operation == Log)
-    Stack_digits.push(std::log10(value));
-  if (Stack_operators.top().operation == Sin)
-    Stack_digits.push(std::sin(value));
-  if (Stack_operators.top().operation == Cos)
-    Stack_digits.push(std::cos(value));
-  if (Stack_operators.top().operation == Tan)
-    Stack_digits.push(std::tan(value));
-  if (Stack_operators.top().operation == Asin) {
+template <typename T>
+T Model::CalculateUnarn(Operation operation, T value) {
+  T res = 0;
+  if (operation == Ln) res = numeric::log(value);
+  if (operation == Log) res = numeric::log10(value);
+  if (operation == Sin) res = numeric::sin(value);
+  if (operation == Cos) res = numeric::cos(value);
+  if (operation == Tan) res = numeric::tan(value);
+  if (operation == Asin) {
     if (value > 1 || value < -1)
       throw std::invalid_argument(
           "value in asin or acos must be in range[-1; 1]");
-    Stack_digits.push(std::asin(value));
+    res = numeric::asin(value);
   }
-  if (Stack_operators.top().operation == Acos) {
+  if (operation == Acos) {
     if (value > 1 || value < -1)
       throw std::invalid_argument(
           "value in asin or acos must be in range[-1; 1]");
-    Stack_digits.push(std::acos(value));
+    res = numeric::acos(value);
   }
-  if (Stack_operators.top().operation == Atan)
-    Stack_digits.push(std::atan(value));
-  if (Stack_operators.top().operation == Sqrt) {
+  if (operation == Atan) res = numeric::atan(value);
+  if (operation == Sqrt) {
     if (value < 0) throw std::invalid_argument("negative in sqrt");
-    Stack_digits.push(std::sqrt(value));
+    res = numeric::sqrt(value);
   }
-  if (Stack_operators.top().operation == UnarnMinus)
-    Stack_digits.push(value * (-1));
-  Stack_operators.pop();
+  if (operation == Root) res = numeric::sqrt(value);
+  if (operation == UnarnMinus) res = value * (-1);
+  return res;
 }
 
-void Model::Calculate(std::stack<double>& Stack_digits,
+// Pops the top operator and turns it into a tree node over the operands on
+// Stack_digits. User function calls are inlined here, so the compiled program
+// never contains a call.
+void Model::Calculate(std::stack<std::size_t>& Stack_digits,
                       std::stack<Leksema>& Stack_operators) {
-  if (IsUnarnOrBinarn(Stack_operators.top().operation) == 2)
-    CalculateBinarn(Stack_digits, Stack_operators);
-  else if (IsUnarnOrBinarn(Stack_operators.top().operation) == 1)
-    CalculateUnarn(Stack_digits, Stack_operators);
+  Leksema element = Stack_operators.top();
+  Stack_operators.pop();
+  std::size_t operands =
+      element.operation == Call ? 1 : IsUnarnOrBinarn(element.operation);
+  if (Stack_digits.size() < operands)
+    throw std::invalid_argument("missing operand");
+  if (element.operation == Call) {
+    std::size_t argument = Stack_digits.top();
+    Stack_digits.pop();
+    Stack_digits.push(Inline(element.symbol, argument));
+  } else if (IsUnarnOrBinarn(element.operation) == 2) {
+    std::size_t first_value = Stack_digits.top();
+    Stack_digits.pop();
+    std::size_t second_value = Stack_digits.top();
+    Stack_digits.pop();
+    Stack_digits.push(
+        AddNode(element.operation, 0, 0, second_value, first_value));
+  } else if (IsUnarnOrBinarn(element.operation) == 1) {
+    std::size_t value = Stack_digits.top();
+    Stack_digits.pop();
+    Stack_digits.push(AddNode(element.operation, 0, 0, value, kNoNode));
+  }
 }
-//
-short Model::AddOperators(std::string expression, short index,
-                          std::stack<double>& Stack_digits,
-                          std::stack<Leksema>& Stack_operators) {
-  if (Stack_operators.empty()) {
-    Stack_operators.push(AddElement(expression, index));
-  } else if (expression[index] == ')') {
-    if (Stack_operators.top().operation == OpenBracket) {
-      Stack_operators.pop();
-    } else if (Stack_operators.top().operation != OpenBracket) {
-      while (Stack_operators.top().operation != OpenBracket)
-        Calculate(Stack_digits, Stack_operators);
-      Stack_operators.pop();
-    }
-  } else if (!Stack_operators.empty() &&
-             get_priority(expression, index) <=
-                 Stack_operators.top().priority &&
-             expression[index] != '(') {
-    Calculate(Stack_digits, Stack_operators);
-    AddOperators(expression, index, Stack_digits, Stack_operators);
-  } else if ((!Stack_operators.empty() && get_priority(expression, index) >
-                                              Stack_operators.top().priority) ||
-             expression[index] == '(') {
-    Stack_operators.push(AddElement(expression, index));
+
+// Before a binary operator is pushed, every operator that binds at least as
+// tight is reduced in a loop, so long chains like 1+2+...+n need no
+// recursion. Brackets, functions and unary minus have no left operand and are
+// pushed as they are, which also makes "(-sin(x))" work.
+std::size_t Model::AddOperators(const std::string& expression,
+                                std::size_t index,
+                                std::stack<std::size_t>& Stack_digits,
+                                std::stack<Leksema>& Stack_operators) {
+  if (expression[index] == ')') {
+    while (!Stack_operators.empty() &&
+           Stack_operators.top().operation != OpenBracket)
+      Calculate(Stack_digits, Stack_operators);
+    if (!Stack_operators.empty()) Stack_operators.pop();
+  } else {
+    Leksema element = AddElement(expression, index);
+    while (IsUnarnOrBinarn(element.operation) == 2 &&
+           !Stack_operators.empty() &&
+           element.priority <= Stack_operators.top().priority)
+      Calculate(Stack_digits, Stack_operators);
+    Stack_operators.push(element);
   }
+  if (get_enum_type(expression, index) == Call)
+    return get_symbol(expression, index).length();
   return get_length(get_enum_type(expression, index));
 }
 
-short Model::AddDigits(std::string expression, short index,
-                       std::stack<double>& Stack_digits) {
-  short start = index;
+// Reads the literal at index, exponent included ("1.5E-3"), in place in the
+// expression. from_chars rounds correctly and ignores the locale. Where the
+// standard library has no floating point from_chars, the double-double
+// reading is rounded instead, which only differs for literals within 1e-32
+// of a halfway case.
+std::size_t Model::AddDigits(const std::string& expression, std::size_t index,
+                             std::stack<std::size_t>& Stack_digits) {
+  const char* first = expression.data() + index;
+  const char* last = first;
   double res = 0;
 
-  while (isdigit(expression[index]) || expression[index] == '.') index++;
-  res = std::stod(expression.substr(start, index));
-  if ((expression[start - 1] == '+' || expression[start - 1] == '-') &&
-      expression[start - 2] == 'E')
-    Stack_digits.push(Stack_digits.top() * std::pow(10, res));
-  else
-    Stack_digits.push(res);
-  index--;
-  return index - start;
+  while (isdigit(*last) || *last == '.') last++;
+  if (*last == 'E') {
+    last++;
+    if (*last == '+' || *last == '-') last++;
+    while (isdigit(*last)) last++;
+  }
+  DoubleDouble extended = ToDoubleDouble(std::string_view(first, last - first));
+#ifdef __cpp_lib_to_chars
+  std::from_chars_result parsed = std::from_chars(first, last, res);
+  if (parsed.ptr != last) throw std::invalid_argument("incorrect number");
+  if (parsed.ec == std::errc::result_out_of_range) res = extended.hi;
+#else
+  res = extended.hi;
+#endif
+  Stack_digits.push(AddNode(Number, res, extended, kNoNode, kNoNode));
+  return last - first - 1;
 }
 
-double Model::CalculateResult(std::stack<double>& Stack_digits,
-                              std::stack<Leksema>& Stack_operators) {
+std::size_t Model::CalculateResult(std::stack<std::size_t>& Stack_digits,
+                                   std::stack<Leksema>& Stack_operators) {
   while (!Stack_operators.empty()) Calculate(Stack_digits, Stack_operators);
+  if (Stack_digits.empty()) throw std::invalid_argument("missing operand");
   return Stack_digits.top();
 }
 
+// Appends a node to the tree. Operators whose operands are all numbers are
+// folded right away, which also folds constants across inlined calls. Folding
+// runs in double and double-double side by side so that the extended modes
+// get constants with all their digits. Operations that are out of the real
+// domain stay in the program: real evaluation reports them and complex mode
+// gives them a value.
+//
+// Pow with a small integer exponent becomes PowInt, which plots evaluate as
+// a multiply chain, and ^0.5 becomes Root, a square root that gives nan
+// instead of throwing like pow does. Equal nodes are shared through shared_.
+std::size_t Model::AddNode(Operation operation, double value,
+                           DoubleDouble extended, std::size_t left,
+                           std::size_t right) {
+  bool binarn = IsUnarnOrBinarn(operation) == 2 &&
+                nodes_[left].operation == Number &&
+                nodes_[right].operation == Number;
+  bool unarn =
+      IsUnarnOrBinarn(operation) == 1 && nodes_[left].operation == Number;
+
+  if (binarn || unarn) try {
+      double folded =
+          binarn ? CalculateBinarn(operation, nodes_[left].value,
+                                   nodes_[right].value)
+                 : CalculateUnarn(operation, nodes_[left].value);
+      if (!std::isnan(folded)) {
+        extended = binarn ? CalculateBinarn(operation, nodes_[left].extended,
+                                            nodes_[right].extended)
+                          : CalculateUnarn(operation, nodes_[left].extended);
+        value = folded;
+        operation = Number;
+        left = right = kNoNode;
+      }
+    } catch (const std::invalid_argument&) {
+    }
+  if (operation == Pow && nodes_[right].operation == Number &&
+      nodes_[right].extended == DoubleDouble(nodes_[right].value)) {
+    double exponent = nodes_[right].value;
+    if (exponent == 0.5) {
+      operation = Root;
+      right = kNoNode;
+    } else if (exponent == std::floor(exponent) &&
+               std::fabs(exponent) <= kMaxPowInt) {
+      operation = PowInt;
+      value = exponent;
+      right = kNoNode;
+    }
+  }
+  auto key =
+      std::make_tuple(operation, Bits(value), Bits(extended.lo), left, right);
+  auto found = shared_.find(key);
+  if (found != shared_.end()) return found->second;
+  shared_[key] = nodes_.size();
+  nodes_.push_back({operation, value, extended, left, right});
+  return nodes_.size() - 1;
+}
+
+// Parses expression into nodes_ and returns its root. Every x is bound to the
+// variable node, or to a fresh Variable node when variable is kNoNode.
+//
+// With incremental set, a group or term listed in groups_ or terms_ is pushed
+// as a ready operand instead of being parsed again, and the ones that are
+// parsed are recorded for the next call. Both are atoms to the operator
+// stack: a ")" reduces down to its "(", and a term is closed by a + or -
+// that reduces everything above the previous one. That only holds for a well
+// formed expression, where operands and binary operators alternate and the
+// brackets match, so for any other one nothing is recorded and kNoNode is
+// returned instead.
+std::size_t Model::BuildTree(std::string expression, std::size_t variable,
+                             bool incremental) {
+  std::stack<std::size_t> Stack_digits;
+  std::stack<Leksema> Stack_operators;
+  std::vector<Level> levels = {{kNoNode, 0, 0, 0}};
+  std::vector<Span> groups, terms;
+  std::size_t group = 0, term = 0;
+  bool term_start = true;
+  bool clean = true, operand = false;
+
+  if (expression == "") return AddNode(Number, 0, 0, kNoNode, kNoNode);
+  if (variable == kNoNode)
+    variable = AddNode(Variable, 0, 0, kNoNode, kNoNode);
+  for (size_t index = 0; index < expression.length(); index++) {
+    const Span* span = nullptr;
+    if (incremental && term_start) span = FindSpan(terms_, term, index);
+    // A reused term is already listed and is not recorded again.
+    if (span) levels.back().term_begin = kNoNode;
+    if (incremental && !span && expression[index] == '(')
+      span = FindSpan(groups_, group, index);
+    term_start = false;
+    if (span) {
+      clean = clean && !operand;
+      operand = true;
+      Stack_digits.push(span->node);
+      index = span->end - 1;
+      continue;
+    }
+    if (expression[index] == '-' && index > 0 && expression[index - 1] == '(')
+      expression[index] = '~';
+    if (expression[index] >= '0' && expression[index] <= '9') {
+      clean = clean && !operand;
+      operand = true;
+      index += AddDigits(expression, index, Stack_digits);
+    } else if (expression[index] == 'x') {
+      clean = clean && !operand;
+      operand = true;
+      Stack_digits.push(variable);
+    } else {
+      Operation operation = get_enum_type(expression, index);
+      bool separator = operation == Add || operation == Sub;
+      bool binarn = IsUnarnOrBinarn(operation) == 2;
+      if (operation == None) clean = false;
+      clean = clean && operand == (binarn || operation == CloseBracket);
+      operand = operation == CloseBracket;
+      if (incremental && (separator || operation == CloseBracket))
+        CloseTerm(index, levels.back(), Stack_digits, Stack_operators, terms);
+      index +=
+          AddOperators(expression, index, Stack_digits, Stack_operators) - 1;
+      if (operation == OpenBracket) {
+        levels.push_back({index, Stack_digits.size(), index + 1,
+                          Stack_digits.size()});
+        term_start = true;
+      } else if (operation == CloseBracket && levels.size() == 1) {
+        clean = false;
+      } else if (operation == CloseBracket) {
+        if (Stack_digits.size() == levels.back().digits + 1)
+          groups.push_back({levels.back().open, index + 1, Stack_digits.top()});
+        levels.pop_back();
+      } else if (separator) {
+        levels.back().term_begin = index + 1;
+        levels.back().term_digits = Stack_digits.size();
+        term_start = true;
+      }
+    }
+  }
+  if (incremental)
+    CloseTerm(expression.length(), levels.back(), Stack_digits,
+              Stack_operators, terms);
+  std::size_t root = CalculateResult(Stack_digits, Stack_operators);
+  if (incremental && (!clean || !operand || levels.size() > 1))
+    return kNoNode;
+  if (incremental) {
+    auto by_begin = [](const Span& a, const Span& b) {
+      return a.begin < b.begin;
+    };
+    for (auto [found, known] : {std::make_pair(&groups, &groups_),
+                                std::make_pair(&terms, &terms_)}) {
+      std::vector<Span> merged(found->size() + known->size());
+      std::sort(found->begin(), found->end(), by_begin);
+      std::merge(found->begin(), found->end(), known->begin(), known->end(),
+                 merged.begin(), by_begin);
+      known->swap(merged);
+    }
+  }
+  return root;
+}
+
+// Reduces the term of level that ends at end down to one node and records it.
+// Reducing it here is what AddOperators or CalculateResult would do next
+// anyway, in the same order.
+void Model::CloseTerm(std::size_t end, const Level& level,
+                      std::stack<std::size_t>& Stack_digits,
+                      std::stack<Leksema>& Stack_operators,
+                      std::vector<Span>& terms) {
+  while (!Stack_operators.empty() &&
+         Stack_operators.top().operation != OpenBracket &&
+         Stack_operators.top().operation != Add &&
+         Stack_operators.top().operation != Sub)
+    Calculate(Stack_digits, Stack_operators);
+  if (end > level.term_begin && Stack_digits.size() == level.term_digits + 1)
+    terms.push_back({level.term_begin, end, Stack_digits.top()});
+}
+
+// Returns the span that starts at begin, if any. Lookups come with growing
+// begin, so cursor only moves forward.
+const Model::Span* Model::FindSpan(const std::vector<Span>& spans,
+                                   std::size_t& cursor, std::size_t begin) {
+  while (cursor < spans.size() && spans[cursor].begin < begin) cursor++;
+  if (cursor < spans.size() && spans[cursor].begin == begin)
+    return &spans[cursor];
+  return nullptr;
+}
+
+// Parses expression and reuses what the previous call parsed. The edit is
+// the part between the longest common prefix and suffix of the old and new
+// text. A span keeps its node if it lies in the unchanged prefix or suffix
+// together with the characters that delimit it; spans in the suffix move by
+// the change in length. Only the rest is lexed and parsed again, so an edit
+// costs about the size of the bracket level and term it touches.
+//
+// nodes_ keeps growing across calls and is rebuilt from scratch once the
+// dead nodes clearly outnumber the live ones.
+std::size_t Model::Parse(const std::string& expression) {
+  if (nodes_.size() > 2 * live_nodes_ + kMinGarbage) ResetParse();
+  bool fresh = nodes_.empty();
+  std::size_t common = std::min(source_.length(), expression.length());
+  std::size_t prefix =
+      std::mismatch(source_.begin(), source_.begin() + common,
+                    expression.begin())
+          .first -
+      source_.begin();
+  std::size_t suffix = 0;
+  while (suffix < common - prefix &&
+         source_[source_.length() - 1 - suffix] ==
+             expression[expression.length() - 1 - suffix])
+    suffix++;
+  std::size_t tail = source_.length() - suffix;
+
+  auto keep = [&](std::vector<Span>& spans, bool term) {
+    std::size_t count = 0;
+    for (Span span : spans) {
+      if (term ? span.end < prefix : span.end <= prefix) {
+        spans[count++] = span;
+      } else if (term ? span.begin > tail : span.begin >= tail) {
+        span.begin = span.begin - source_.length() + expression.length();
+        span.end = span.end - source_.length() + expression.length();
+        spans[count++] = span;
+      }
+    }
+    spans.resize(count);
+  };
+  keep(groups_, false);
+  keep(terms_, true);
+
+  std::size_t root = kNoNode;
+  try {
+    inline_depth_ = 0;
+    root = BuildTree(expression, kNoNode, true);
+  } catch (...) {
+    ResetParse();
+    throw;
+  }
+  if (root == kNoNode) {
+    ResetParse();
+    return BuildTree(expression, kNoNode);
+  }
+  source_ = expression;
+  if (fresh) live_nodes_ = nodes_.size();
+  return root;
+}
+
+void Model::ResetParse() {
+  nodes_.clear();
+  shared_.clear();
+  source_.clear();
+  groups_.clear();
+  terms_.clear();
+  live_nodes_ = 0;
+}
+
+std::size_t Model::Inline(std::string symbol, std::size_t argument) {
+  auto function = functions_.find(symbol);
+  if (function == functions_.end())
+    throw std::invalid_argument("unknown function " + symbol);
+  if (inline_depth_ >= kMaxInlineDepth)
+    throw std::invalid_argument("recursive function " + symbol);
+  inline_depth_++;
+  std::size_t res = BuildTree(function->second.body, argument);
+  inline_depth_--;
+  return res;
+}
+
+// Returns the cos node over the same argument as a sin node and the other
+// way round, or kNoNode. A partner that is never emitted only costs an
+// unused slot.
+std::size_t Model::Partner(std::size_t node) {
+  Node element = nodes_[node];
+  std::size_t res = kNoNode;
+  if (element.operation == Sin || element.operation == Cos) {
+    Operation other = element.operation == Sin ? Cos : Sin;
+    auto found =
+        shared_.find(std::make_tuple(other, Bits(0.0), Bits(0.0),
+                                     element.left, kNoNode));
+    if (found != shared_.end()) res = found->second;
+  }
+  return res;
+}
+
+// Post-order walk over the tree with an explicit stack, so that the deep
+// trees of long generated expressions cannot overflow the call stack. The
+// first of a sin/cos pair to be emitted computes both with SinCos or CosSin
+// and parks the other one in a slot; the second one is a Load.
+void Model::Emit(std::size_t root, Program& program) {
+  std::vector<std::pair<std::size_t, bool>> pending = {{root, false}};
+  std::size_t depth = 0;
+
+  while (!pending.empty()) {
+    auto [node, operands_done] = pending.back();
+    Node element = nodes_[node];
+    double low = std::isfinite(element.value)
+                     ? (element.extended - element.value).hi
+                     : 0;
+    Instruction instruction = {element.operation, element.value, low, 0};
+    bool leaf = element.operation == Number ||
+                element.operation == Variable || slots_[node] != kNoNode;
+
+    if (!leaf && !operands_done) {
+      pending.back().second = true;
+      if (IsUnarnOrBinarn(element.operation) == 2)
+        pending.push_back({element.right, false});
+      pending.push_back({element.left, false});
+      continue;
+    }
+    pending.pop_back();
+    if (slots_[node] != kNoNode) {
+      instruction = {Load, 0, 0, slots_[node]};
+      depth++;
+    } else if (leaf) {
+      depth++;
+    } else if (IsUnarnOrBinarn(element.operation) == 2) {
+      depth--;
+    } else {
+      std::size_t partner = Partner(node);
+      if (partner != kNoNode && slots_[partner] == kNoNode) {
+        slots_[partner] = program.slots++;
+        instruction = {element.operation == Sin ? SinCos : CosSin, 0, 0,
+                       slots_[partner]};
+      }
+    }
+    program.depth = std::max(program.depth, depth);
+    program.code.push_back(instruction);
+  }
+}
+
+// Takes node apart as core * a + b, core / a + b, b - core * a and so on
+// with constant a and b, storing them in affine, and returns core. The
+// subtractions become additions of negated values, which round the same.
+std::size_t Model::MatchAffine(std::size_t node, Affine& affine) {
+  Node element = nodes_[node];
+  bool reversed = false;
+  if (element.operation == Add || element.operation == Sub) {
+    Node left = nodes_[element.left];
+    Node right = nodes_[element.right];
+    if (right.operation == Number) {
+      affine.b = element.operation == Sub ? -right.value : right.value;
+      node = element.left;
+    } else if (left.operation == Number) {
+      affine.b = left.value;
+      reversed = element.operation == Sub;
+      node = element.right;
+    }
+  }
+  element = nodes_[node];
+  if (element.operation == Mult || element.operation == Div) {
+    Node left = nodes_[element.left];
+    Node right = nodes_[element.right];
+    if (right.operation == Number &&
+        (element.operation == Mult || right.value != 0)) {
+      affine.a = right.value;
+      affine.divide = element.operation == Div;
+      node = element.left;
+    } else if (left.operation == Number && element.operation == Mult) {
+      affine.a = left.value;
+      node = element.right;
+    }
+  }
+  if (reversed) affine.a = -affine.a;
+  return node;
+}
+
+// A constant, x or x^n, possibly times or over a constant.
+bool Model::MatchMonomial(std::size_t node, Monomial& term) {
+  Node element = nodes_[node];
+  term = {Number, 0, 1, false};
+  if (element.operation == Number) {
+    term.coefficient = element.value;
+    return true;
+  }
+  if (element.operation == Mult || element.operation == Div) {
+    Node left = nodes_[element.left];
+    Node right = nodes_[element.right];
+    if (right.operation == Number &&
+        (element.operation == Mult || right.value != 0)) {
+      term.coefficient = right.value;
+      term.divide = element.operation == Div;
+      element = left;
+    } else if (left.operation == Number && element.operation == Mult) {
+      term.coefficient = left.value;
+      element = right;
+    }
+  }
+  term.base = element.operation;
+  bool power = element.operation == PowInt &&
+               nodes_[element.left].operation == Variable;
+  if (power) term.power = static_cast<int>(element.value);
+  return power || element.operation == Variable;
+}
+
+// Recognizes the forms most plots take: a*x+b, a*sin(b*x+c) and the other
+// functions of an affine argument, a*c^(b*x) and polynomials written as a
+// sum of terms. ExecuteShape() runs them in a few flat loops per block
+// instead of one per instruction, with the same operations in the same
+// order, so results do not change. Anything else keeps Shape::function at
+// None.
+Model::Shape Model::MatchShape(std::size_t root) {
+  Shape shape;
+  if (nodes_[root].operation == Number) return shape;
+  std::size_t core = MatchAffine(root, shape.outer);
+  Node element = nodes_[core];
+  std::size_t argument = core;
+  shape.function = Variable;
+  if (element.operation == Sin || element.operation == Cos ||
+      element.operation == Ln || element.operation == Log) {
+    shape.function = element.operation;
+    argument = element.left;
+  } else if (element.operation == Pow &&
+             nodes_[element.left].operation == Number) {
+    shape.function = Pow;
+    shape.base = nodes_[element.left].value;
+    argument = element.right;
+  }
+  if (nodes_[MatchAffine(argument, shape.inner)].operation == Variable)
+    return shape;
+
+  shape = Shape();
+  shape.function = Add;
+  Monomial term;
+  std::size_t node = root;
+  while ((nodes_[node].operation == Add || nodes_[node].operation == Sub) &&
+         MatchMonomial(nodes_[node].right, term)) {
+    if (nodes_[node].operation == Sub) term.coefficient = -term.coefficient;
+    shape.terms.push_back(term);
+    node = nodes_[node].left;
+  }
+  if (!MatchMonomial(node, term)) return Shape();
+  shape.terms.push_back(term);
+  std::reverse(shape.terms.begin(), shape.terms.end());
+
+  for (const Monomial& monomial : shape.terms) {
+    int power = monomial.base == Number     ? 0
+                : monomial.base == Variable ? 1
+                                            : monomial.power;
+    if (power < 0) {
+      shape.coefficients.clear();
+      break;
+    }
+    if (shape.coefficients.size() <= static_cast<std::size_t>(power))
+      shape.coefficients.resize(power + 1);
+    shape.coefficients[power] += monomial.divide ? 1 / monomial.coefficient
+                                                 : monomial.coefficient;
+  }
+  return shape;
+}
+
+Model::Program Model::Compile(std::string expression) {
+  Program program;
+
+  std::size_t root = Parse(expression);
+  slots_.assign(nodes_.size(), kNoNode);
+  Emit(root, program);
+  program.shape = MatchShape(root);
+  return program;
+}
+
+template <typename T>
+T Model::Run(const Program& program, T x, T* registers) {
+  T* top = registers - 1;
+  T* slots = registers + program.depth;
+
+  for (const Instruction& instruction : program.code) {
+    if (instruction.operation == Number) {
+      *++top = Constant<T>(instruction);
+    } else if (instruction.operation == Variable) {
+      *++top = x;
+    } else if (instruction.operation == Load) {
+      *++top = slots[instruction.slot];
+    } else if (IsUnarnOrBinarn(instruction.operation) == 2) {
+      top--;
+      *top = CalculateBinarn(instruction.operation, top[0], top[1]);
+    } else if (instruction.operation == PowInt) {
+      *top = numeric::pow(*top, T(instruction.value));
+    } else if (instruction.operation == SinCos) {
+      slots[instruction.slot] = numeric::cos(*top);
+      *top = numeric::sin(*top);
+    } else if (instruction.operation == CosSin) {
+      slots[instruction.slot] = numeric::sin(*top);
+      *top = numeric::cos(*top);
+    } else {
+      *top = CalculateUnarn(instruction.operation, *top);
+    }
+  }
+  return *top;
+}
+
+double Model::Execute(const Program& program, double x) {
+  std::size_t size = program.depth + program.slots;
+  if (registers_.size() < size) registers_.resize(size);
+  return Run(program, x, registers_.data());
+}
+
+// Evaluates in the requested precision and returns kExtendedDigits
+// significant digits, since the result does not fit in a double.
+std::string Model::ProcessingExtended(std::string expression, double x,
+                                      Precision precision) {
+  Program program = Compile(expression);
+  std::string res;
+
+  if (precision == PrecisionDoubleDouble) {
+    std::vector<DoubleDouble> registers(program.depth + program.slots);
+    res = ToString(Run(program, DoubleDouble(x), registers.data()),
+                   kExtendedDigits);
+#ifdef MODEL_HAS_FLOAT128
+  } else if (precision == PrecisionFloat128) {
+    std::vector<Float128> registers(program.depth + program.slots);
+    res = ToString(Run(program, Float128(x), registers.data()),
+                   kExtendedDigits);
+#endif
+  } else {
+    res = ToString(DoubleDouble(Execute(program, x)), kExtendedDigits);
+  }
+  return res;
+}
+
+bool Model::HasPrecision([[maybe_unused]] Precision precision) {
+  bool res = true;
+#ifndef MODEL_HAS_FLOAT128
+  if (precision == PrecisionFloat128) res = false;
+#endif
+  return res;
+}
+
 bool Model::IsCorrectBrackets(std::string expression) {
-  short counter = 0;
+  long counter = 0;
   bool res = true;
 
   for (size_t i = 0; i < expression.length(); i++) {
@@ -211,57 +820,239 @@ bool Model::IsCorrectBrackets(std::string expression) {
 
 bool Model::IsCorrectExpression(std::string expression) {
   bool is_ok = true;
-  short len = expression.length() - 1;
 
-  if (len > 255 || !IsCorrectBrackets(expression)) is_ok = false;
+  if (expression.empty() || !IsCorrectBrackets(expression) ||
+      !HasKnownNames(expression))
+    return false;
+  std::size_t len = expression.length() - 1;
   if (!isdigit(expression[len]) && expression[len] != ')') is_ok = false;
   return is_ok;
 }
 
 double Model::Processing(std::string expression, double x) {
-  std::stack<double> Stack_digits;
-  std::stack<Leksema> Stack_operators;
-
   if (expression == "") return 0;
-  for (size_t index = 0; index < expression.length(); index++) {
-    if (expression[index] == '-' && expression[index - 1] == '(')
-      expression[index] = '~';
-    if (expression[index] >= '0' && expression[index] <= '9')
-      index += AddDigits(expression, index, Stack_digits);
-    else if (expression[index] == 'x')
-      Stack_digits.push(x);
-    else if (expression[index] == 'E')
+  return Execute(Compile(expression), x);
+}
+
+// Accepts "name(parameter)=body", e.g. "g(t)=t^2+sin(t)". Names and the
+// parameter are lowercase words that do not clash with built-in functions.
+// The body is stored with its parameter renamed to x and is inlined into
+// every expression that calls the function. Bodies with unknown names, that
+// do not compile or that call the function itself are refused. Returns the
+// name, without the spaces the definition may have had, or an empty string
+// if it is refused.
+std::string Model::DefineFunction(std::string definition) {
+  definition.erase(std::remove(definition.begin(), definition.end(), ' '),
+                   definition.end());
+  size_t open = definition.find('(');
+  size_t close = definition.find(')');
+  if (open == std::string::npos || close == std::string::npos ||
+      definition[close + 1] != '=')
+    return "";
+
+  std::string name = definition.substr(0, open);
+  std::string parameter = definition.substr(open + 1, close - open - 1);
+  std::string body = definition.substr(close + 2);
+  auto is_word = [](const std::string& word) {
+    return !word.empty() &&
+           std::all_of(word.begin(), word.end(),
+                       [](char c) { return c >= 'a' && c <= 'z'; });
+  };
+  auto is_reserved = [](const std::string& word) {
+    return std::find(std::begin(kReserved), std::end(kReserved), word) !=
+           std::end(kReserved);
+  };
+  std::string renamed;
+  if (!is_word(name) || !is_word(parameter) || body.empty() ||
+      name.find('x') != std::string::npos || is_reserved(name) ||
+      (parameter != "x" && is_reserved(parameter)) ||
+      !IsCorrectBrackets(body) || !ReadWords(body, name, parameter, &renamed))
+    return "";
+
+  // The body is compiled with the new definition in place, which reports
+  // errors in it and calls of the function from itself.
+  std::map<std::string, Function> previous = functions_;
+  functions_[name] = {definition, renamed};
+  ResetParse();
+  try {
+    Compile(renamed);
+  } catch (const std::invalid_argument&) {
+    functions_.swap(previous);
+    ResetParse();
+    return "";
+  }
+  ResetParse();
+  return name;
+}
+
+// Copies expression to renamed with the parameter renamed to x, reading it
+// the way BuildTree() does: calls of user functions and of the function
+// called name, then built-in names, so that "tmod2" is t mod 2, and only
+// then the parameter. False at any other word.
+bool Model::ReadWords(const std::string& expression, const std::string& name,
+                      const std::string& parameter, std::string* renamed) {
+  for (size_t index = 0; index < expression.length();) {
+    if (expression[index] < 'a' || expression[index] > 'z') {
+      if (renamed) *renamed += expression[index];
       index++;
-    else
-      index +=
-          AddOperators(expression, index, Stack_digits, Stack_operators) - 1;
+      continue;
+    }
+    std::string word = get_symbol(expression, index);
+    if (word.empty() && !name.empty() &&
+        expression.compare(index, name.length(), name) == 0 &&
+        expression[index + name.length()] == '(')
+      word = name;
+    for (size_t i = 1; i < std::size(kReserved) && word.empty(); i++)
+      if (expression.compare(index, kReserved[i].length(), kReserved[i]) == 0)
+        word = std::string(kReserved[i]);
+    if (!word.empty()) {
+      if (renamed) *renamed += word;
+    } else if (expression.compare(index, parameter.length(), parameter) == 0) {
+      if (renamed) *renamed += 'x';
+      word = parameter;
+    } else {
+      return false;
+    }
+    index += word.length();
   }
-  return CalculateResult(Stack_digits, Stack_operators);
+  return true;
 }
 
-std::vector<double> Model::GetXCoordinate(double xmin, double xmax) {
-  std::vector<double> x;
-  double step = 0.001 * (fabs(xmin) + fabs(xmax));
-  double X = xmin;
+// True if every word of expression is x, a built-in function or a call of a
+// user function; the parser would skip any other letters.
+bool Model::HasKnownNames(std::string expression) {
+  return ReadWords(expression, "", "x", nullptr);
+}
 
-  while (X < xmax) {
-    x.push_back(X);
-    X += step;
+// Refuses to remove a function that others call, which would leave them
+// with a name the parser skips.
+bool Model::RemoveFunction(std::string name) {
+  auto function = functions_.find(name);
+  if (function == functions_.end()) return false;
+  Function removed = function->second;
+  functions_.erase(function);
+  for (const auto& other : functions_) {
+    if (!HasKnownNames(other.second.body)) {
+      functions_[name] = removed;
+      return false;
+    }
   }
+  ResetParse();
+  return true;
+}
+
+std::map<std::string, std::string> Model::GetFunctions() {
+  std::map<std::string, std::string> res;
+  for (const auto& function : functions_)
+    res[function.first] = function.second.definition;
+  return res;
+}
+
+double Model::GridStep(double xmin, double xmax) {
+  return 0.001 * (fabs(xmin) + fabs(xmax));
+}
+
+// The number of points xmin + i * step below xmax, which is what the
+// sampling functions below produce for [xmin, xmax].
+std::size_t Model::CountCoordinates(double xmin, double xmax) {
+  double step = GridStep(xmin, xmax);
+  if (!(xmin < xmax) || !(step > 0)) return 0;
+  std::size_t res = static_cast<std::size_t>(std::ceil((xmax - xmin) / step));
+  while (res > 0 && !(xmin + (res - 1) * step < xmax)) res--;
+  while (xmin + res * step < xmax) res++;
+  return res;
+}
+
+// Points are computed as xmin + i * step rather than summed up, so that the
+// plot tier can sample them with the recurrences of ExecuteGrid().
+std::vector<double> Model::GetXCoordinate(double xmin, double xmax) {
+  std::vector<double> x(CountCoordinates(xmin, xmax));
+  double step = GridStep(xmin, xmax);
+
+  for (std::size_t i = 0; i < x.size(); i++) x[i] = xmin + i * step;
   return x;
 }
 
 std::vector<double> Model::GetYCoordinate(std::string str, double xmin,
-                                          double xmax) {
+                                          double xmax, Accuracy accuracy) {
   std::vector<double> y;
-  double step = 0.001 * (fabs(xmin) + fabs(xmax));
-  double Y = 0;
-  double X = xmin;
-
-  while (X < xmax) {
-    Y = Processing(str, X);
-    y.push_back(Y);
-    X += step;
+  VectorSink sink(y);
+
+  GetCoordinates(str, xmin, xmax, accuracy, sink);
+  return y;
+}
+
+Model::Program Model::CompileGraph(std::string str, double xmin, double xmax,
+                                   Accuracy accuracy) {
+  Program program = Compile(str);
+  if (accuracy == AccuracyPlot) AttachProxy(program, xmin, xmax);
+  return program;
+}
+
+// Points first .. first + count - 1 of the graph into x and y.
+void Model::SampleGraph(const Program& program, double xmin, double xmax,
+                        Accuracy accuracy, std::size_t first, double* x,
+                        double* y, std::size_t count) {
+  double step = GridStep(xmin, xmax);
+  for (std::size_t i = 0; i < count; i++) x[i] = xmin + (first + i) * step;
+  if (accuracy == AccuracyPlot)
+    ExecuteGrid(program, xmin, step, first, y, count);
+  else
+    ExecuteBatch(program, x, y, count, accuracy);
+}
+
+// Samples the graph kGraphBlock points at a time, so that the sink receives
+// them while they are in cache and nothing the size of the graph is
+// allocated besides what the sink keeps.
+void Model::GetCoordinates(std::string str, double xmin, double xmax,
+                           Accuracy accuracy, Sink& sink) {
+  std::size_t count = CountCoordinates(xmin, xmax);
+  Program program = CompileGraph(str, xmin, xmax, accuracy);
+
+  sink.Resize(count);
+  std::vector<double> x(std::min(count, kGraphBlock));
+  std::vector<double> y(x.size());
+  for (std::size_t begin = 0; begin < count; begin += kGraphBlock) {
+    std::size_t size = std::min(kGraphBlock, count - begin);
+    SampleGraph(program, xmin, xmax, accuracy, begin, x.data(), y.data(),
+                size);
+    sink.Write(begin, x.data(), y.data(), size);
   }
+}
+
+// Samples the graph in one pass into buffers the caller keeps, say from one
+// frame to the next, and returns the number of points, which
+// CountCoordinates() tells in advance. Throws if capacity is less.
+std::size_t Model::GetCoordinates(std::string str, double xmin, double xmax,
+                                  Accuracy accuracy, double* x, double* y,
+                                  std::size_t capacity) {
+  std::size_t count = CountCoordinates(xmin, xmax);
+  if (capacity < count) throw std::invalid_argument("buffer is too small");
+  SampleGraph(CompileGraph(str, xmin, xmax, accuracy), xmin, xmax, accuracy,
+              0, x, y, count);
+  return count;
+}
+
+std::complex<double> Model::ProcessingComplex(std::string expression,
+                                              double x) {
+  double real = 0;
+  double imag = 0;
+
+  if (expression != "")
+    ExecuteComplexBatch(Compile(expression), &x, &real, &imag, 1);
+  return {real, imag};
+}
+
+std::vector<double> Model::GetYCoordinateComplex(std::string str, double xmin,
+                                                 double xmax,
+                                                 ComplexPart part) {
+  std::vector<double> x = GetXCoordinate(xmin, xmax);
+  std::vector<double> y(x.size());
+  std::vector<double> imag(x.size());
+
+  ExecuteComplexBatch(Compile(str), x.data(), y.data(), imag.data(), x.size());
+  if (part == PartImag) y.swap(imag);
+  if (part == PartAbs)
+    for (size_t i = 0; i < y.size(); i++) y[i] = std::hypot(y[i], imag[i]);
   return y;
 }
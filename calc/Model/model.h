@@ -1,21 +1,23 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+#include <complex>
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <stack>
 #include <string>
+#include <tuple>
 #include <vector>
 
+#include "numeric.h"
+
+namespace jit {
+class Function;
+}
+
 class Model {
  public:
-  Model() {}
-  ~Model() {}
-  bool IsCorrectExpression(std::string expression);
-  double Processing(std::string expression, double x);
-  bool IsCorrectBrackets(std::string expression);
-  std::vector<double> GetXCoordinate(double xmin, double xmax);
-  std::vector<double> GetYCoordinate(std::string str, double xmin, double xmax);
-
- private:
   enum Operation {
     None,
     Add,
@@ -36,34 +38,290 @@ class Model {
     Acos,
     Atan,
     UnarnMinus,
-    Exp
+    Exp,
+    Number,
+    Variable,
+    Call,
+    // Produced by the optimizer only, never by the lexer.
+    PowInt,
+    Root,
+    SinCos,
+    CosSin,
+    Load
+  };
+
+  // Plot uses the SIMD kernels in kernels.h, Result uses libm.
+  enum Accuracy { AccuracyResult, AccuracyPlot };
+
+  enum ComplexPart { PartReal, PartImag, PartAbs };
+
+  enum Precision { PrecisionDouble, PrecisionDoubleDouble, PrecisionFloat128 };
+
+  enum Interpolation { InterpolationLinear, InterpolationCubic };
+
+  // value is the constant as the double path sees it; value + low carries
+  // the extra digits for the extended precision modes. PowInt keeps its
+  // exponent in value. SinCos and CosSin leave one function on the stack and
+  // store the other into slot, Load pushes a slot back.
+  struct Instruction {
+    Operation operation;
+    double value;
+    double low;
+    std::size_t slot;
+  };
+
+  // v * a + b, or v / a + b with divide set. The defaults leave v as is.
+  struct Affine {
+    double a = 1;
+    double b = -0.0;
+    bool divide = false;
+  };
+
+  // One term of a polynomial: 1, x or x^power (base Number, Variable or
+  // PowInt) times coefficient, or divided by it.
+  struct Monomial {
+    Operation base;
+    int power;
+    double coefficient;
+    bool divide;
+  };
+
+  // A common form of expression with its own batch loops, see MatchShape():
+  // outer(function(inner(x))) with function Sin, Cos, Ln, Log, Pow (for
+  // base^inner) or Variable (for none), or the sum of terms when function is
+  // Add. None if the program has no such form. A sum of terms with powers
+  // from 0 to kMaxPowInt also has its coefficients by power, for Horner's
+  // scheme.
+  struct Shape {
+    Operation function = None;
+    double base = 0;
+    Affine inner;
+    Affine outer;
+    std::vector<Monomial> terms;
+    std::vector<double> coefficients;
+  };
+
+  // Chebyshev series of a program on [xmin, xmax], see BuildProxy(). Empty
+  // coefficients if there is none.
+  struct Proxy {
+    double xmin = 0;
+    double xmax = 0;
+    std::vector<double> coefficients;
+  };
+
+  // An expression tabulated at size points evenly spaced over [xmin, xmax],
+  // see Tabulate(). error is the largest difference from the expression
+  // found between the points.
+  struct Table {
+    struct alignas(64) Line {
+      double value[8];
+    };
+    double xmin = 0;
+    double xmax = 0;
+    double scale = 0;
+    std::size_t size = 0;
+    Interpolation interpolation = InterpolationLinear;
+    std::vector<Line> lines;
+    double error = 0;
+  };
+
+  // Slots live in the register file right after the depth stack registers.
+  struct Program {
+    std::vector<Instruction> code;
+    std::size_t depth = 0;
+    std::size_t slots = 0;
+    Shape shape;
+    Proxy proxy;
+  };
+
+  // Receives the points of a graph in blocks, in order of x: Resize() with
+  // their number first, then Write() with x and y of the points from index
+  // on. See GetCoordinates().
+  class Sink {
+   public:
+    virtual ~Sink() {}
+    virtual void Resize(std::size_t count) = 0;
+    virtual void Write(std::size_t index, const double* x, const double* y,
+                       std::size_t count) = 0;
   };
 
+  Model() {}
+  ~Model() {}
+  bool IsCorrectExpression(std::string expression);
+  double Processing(std::string expression, double x);
+  bool IsCorrectBrackets(std::string expression);
+  bool HasKnownNames(std::string expression);
+  std::vector<double> GetXCoordinate(double xmin, double xmax);
+  std::vector<double> GetYCoordinate(std::string str, double xmin, double xmax,
+                                     Accuracy accuracy = AccuracyPlot);
+  static double GridStep(double xmin, double xmax);
+  static std::size_t CountCoordinates(double xmin, double xmax);
+  void GetCoordinates(std::string str, double xmin, double xmax,
+                      Accuracy accuracy, Sink& sink);
+  std::size_t GetCoordinates(std::string str, double xmin, double xmax,
+                             Accuracy accuracy, double* x, double* y,
+                             std::size_t capacity);
+
+  Program Compile(std::string expression);
+  double Execute(const Program& program, double x);
+  std::string ProcessingExtended(std::string expression, double x,
+                                 Precision precision);
+  static bool HasPrecision(Precision precision);
+
+  bool BuildProxy(Program& program, double xmin, double xmax,
+                  double tolerance);
+  void ExecuteBatch(const Program& program, const double* x, double* y,
+                    std::size_t count, Accuracy accuracy = AccuracyResult);
+  void ExecuteGrid(const Program& program, double x0, double step,
+                   std::size_t first, double* y, std::size_t count);
+  void ExecuteComplexBatch(const Program& program, const double* x,
+                           double* real, double* imag, std::size_t count);
+  std::complex<double> ProcessingComplex(std::string expression, double x);
+  std::vector<double> GetYCoordinateComplex(std::string str, double xmin,
+                                            double xmax, ComplexPart part);
+  std::string ExportCpp(std::string expression, std::string name);
+  Table Tabulate(std::string expression, double xmin, double xmax,
+                 std::size_t size, Interpolation interpolation);
+  static double Lookup(const Table& table, double x);
+  static void LookupBatch(const Table& table, const double* x, double* y,
+                          std::size_t count);
+
+  std::string DefineFunction(std::string definition);
+  bool RemoveFunction(std::string name);
+  std::map<std::string, std::string> GetFunctions();
+
+ private:
   struct Leksema {
     Operation operation;
     char priority;
+    std::string symbol;
   };
 
-  Operation get_enum_type(std::string expression, short index);
+  struct Node {
+    Operation operation;
+    double value;
+    DoubleDouble extended;
+    std::size_t left;
+    std::size_t right;
+  };
+
+  struct Function {
+    std::string definition;
+    std::string body;
+  };
+
+  // Piece of the last parsed expression with its node: a bracket group
+  // "(...)" with end past the ")", or a term between the + and - of one
+  // bracket level with end at the character that closes it.
+  struct Span {
+    std::size_t begin;
+    std::size_t end;
+    std::size_t node;
+  };
+
+  // Open bracket level while parsing: where it and its current term start,
+  // and how many operands were on the stack at those points.
+  struct Level {
+    std::size_t open;
+    std::size_t digits;
+    std::size_t term_begin;
+    std::size_t term_digits;
+  };
+
+  static constexpr std::size_t kNoNode = static_cast<std::size_t>(-1);
+  static constexpr short kMaxInlineDepth = 32;
+  static constexpr int kExtendedDigits = 30;
+  static constexpr std::size_t kBatchSize = 256;
+  static constexpr int kMaxPowInt = 32;
+  static constexpr std::size_t kMinGarbage = 4096;
+  static constexpr std::size_t kJitMinCount = 16384;
+  static constexpr std::size_t kGraphBlock = 4096;
+
+  Operation get_enum_type(const std::string& expression, std::size_t index);
   short get_length(Operation operation);
-  short get_priority(std::string expression, short index);
-
-  Leksema AddElement(std::string expression, short index);
-  void CalculateBinarn(std::stack<double>& Stack_digits,
-                       std::stack<Leksema>& Stack_operators);
-  void CalculateUnarn(std::stack<double>& Stack_digits,
-                      std::stack<Leksema>& Stack_operators);
-  void Calculate(std::stack<double>& Stack_digits,
+  short get_priority(const std::string& expression, std::size_t index);
+  std::string get_symbol(const std::string& expression, std::size_t index);
+  bool ReadWords(const std::string& expression, const std::string& name,
+                 const std::string& parameter, std::string* renamed);
+
+  Leksema AddElement(const std::string& expression, std::size_t index);
+  template <typename T>
+  T CalculateBinarn(Operation operation, T second_value, T first_value);
+  template <typename T>
+  T CalculateUnarn(Operation operation, T value);
+  template <typename T>
+  T Run(const Program& program, T x, T* registers);
+  void Calculate(std::stack<std::size_t>& Stack_digits,
                  std::stack<Leksema>& Stack_operators);
-  short AddOperators(std::string expression, short index,
-                     std::stack<double>& Stack_digits,
-                     std::stack<Leksema>& Stack_operators);
-  short AddDigits(std::string expression, short index,
-                  std::stack<double>& Stack_digits);
-  double CalculateResult(std::stack<double>& Stack_digits,
-                         std::stack<Leksema>& Stack_operators);
+  std::size_t AddOperators(const std::string& expression, std::size_t index,
+                           std::stack<std::size_t>& Stack_digits,
+                           std::stack<Leksema>& Stack_operators);
+  std::size_t AddDigits(const std::string& expression, std::size_t index,
+                        std::stack<std::size_t>& Stack_digits);
+  std::size_t CalculateResult(std::stack<std::size_t>& Stack_digits,
+                              std::stack<Leksema>& Stack_operators);
+
+  Program CompileGraph(std::string str, double xmin, double xmax,
+                       Accuracy accuracy);
+  void SampleGraph(const Program& program, double xmin, double xmax,
+                   Accuracy accuracy, std::size_t first, double* x, double* y,
+                   std::size_t count);
+
+  std::size_t AddNode(Operation operation, double value,
+                      DoubleDouble extended, std::size_t left,
+                      std::size_t right);
+  std::size_t BuildTree(std::string expression, std::size_t variable,
+                        bool incremental = false);
+  void CloseTerm(std::size_t end, const Level& level,
+                 std::stack<std::size_t>& Stack_digits,
+                 std::stack<Leksema>& Stack_operators,
+                 std::vector<Span>& terms);
+  const Span* FindSpan(const std::vector<Span>& spans, std::size_t& cursor,
+                       std::size_t begin);
+  std::size_t Parse(const std::string& expression);
+  void ResetParse();
+  std::size_t Inline(std::string symbol, std::size_t argument);
+  std::size_t Partner(std::size_t node);
+  void Emit(std::size_t root, Program& program);
+  std::size_t MatchAffine(std::size_t node, Affine& affine);
+  bool MatchMonomial(std::size_t node, Monomial& term);
+  Shape MatchShape(std::size_t root);
+  void ExecuteShape(const Shape& shape, const double* x, double* y,
+                    std::size_t count, Accuracy accuracy);
+  bool ExecuteNative(const Program& program, const double* x, double* y,
+                     std::size_t count);
+  static bool SameCode(const std::vector<Instruction>& a,
+                       const std::vector<Instruction>& b);
+  static bool ExecuteProxy(const Proxy& proxy, const double* x, double* y,
+                           std::size_t count);
+  void AttachProxy(Program& program, double xmin, double xmax);
 
   short IsUnarnOrBinarn(Operation operation);
+
+  std::vector<Node> nodes_;
+  // Nodes by (operation, value, extended.lo, left, right), so that equal
+  // subexpressions share a node and sin/cos pairs can be found. The numbers
+  // are keyed by their bits, which tell -0.0 from 0.0.
+  std::map<std::tuple<Operation, std::uint64_t, std::uint64_t, std::size_t,
+                      std::size_t>,
+           std::size_t>
+      shared_;
+  std::vector<std::size_t> slots_;
+  // Incremental parsing state, see Parse().
+  std::string source_;
+  std::vector<Span> groups_;
+  std::vector<Span> terms_;
+  std::size_t live_nodes_ = 0;
+  std::map<std::string, Function> functions_;
+  short inline_depth_ = 0;
+  std::vector<double> registers_;
+  std::vector<double> batch_;
+  // Native code for the plot tier and the program it was built from.
+  std::shared_ptr<jit::Function> native_;
+  std::vector<Instruction> native_code_;
+  // The last graph's program and its proxy, see AttachProxy().
+  std::vector<Instruction> graph_code_;
+  Proxy graph_proxy_;
 };
 
 #endif  // MODEL_H
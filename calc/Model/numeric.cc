@@ -0,0 +1,249 @@
+#include "numeric.h"
+
+#include <algorithm>
+#include <clocale>
+#include <limits>
+
+namespace {
+
+const DoubleDouble kHalfPi(1.5707963267948966, 6.123233995736766e-17);
+const DoubleDouble kLn2(0.6931471805599453, 2.3190468138462996e-17);
+const DoubleDouble kLn10(2.302585092994046, -2.1707562233822494e-16);
+const double kEpsilon = 1e-33;
+
+DoubleDouble Ldexp(DoubleDouble a, int exponent) {
+  return DoubleDouble(std::ldexp(a.hi, exponent), std::ldexp(a.lo, exponent));
+}
+
+DoubleDouble Abs(DoubleDouble a) { return a.hi < 0 ? -a : a; }
+
+DoubleDouble Trunc(DoubleDouble a) {
+  return a.hi < 0 ? -numeric::floor(-a) : numeric::floor(a);
+}
+
+// Taylor series of sin and cos for |a| <= pi / 4.
+void SinCosTaylor(DoubleDouble a, DoubleDouble& sin_a, DoubleDouble& cos_a) {
+  DoubleDouble square = a * a;
+  DoubleDouble term = a;
+  sin_a = a;
+  for (int n = 2; std::fabs(term.hi) > kEpsilon; n += 2) {
+    term = term * square / DoubleDouble(-n * (n + 1.0));
+    sin_a = sin_a + term;
+  }
+  term = 1;
+  cos_a = 1;
+  for (int n = 1; std::fabs(term.hi) > kEpsilon; n += 2) {
+    term = term * square / DoubleDouble(-n * (n + 1.0));
+    cos_a = cos_a + term;
+  }
+}
+
+void SinCos(DoubleDouble a, DoubleDouble& sin_a, DoubleDouble& cos_a) {
+  double quadrant = std::nearbyint((a / kHalfPi).hi);
+  DoubleDouble s, c;
+  SinCosTaylor(a - kHalfPi * quadrant, s, c);
+  int k = static_cast<int>(std::fmod(quadrant, 4.0));
+  if (k < 0) k += 4;
+  sin_a = k == 0 ? s : k == 1 ? c : k == 2 ? -s : -c;
+  cos_a = k == 0 ? c : k == 1 ? -s : k == 2 ? -c : s;
+}
+
+}  // namespace
+
+namespace numeric {
+
+DoubleDouble floor(DoubleDouble a) {
+  double hi = std::floor(a.hi);
+  if (hi != a.hi) return DoubleDouble(hi);
+  return QuickTwoSum(hi, std::floor(a.lo));
+}
+
+DoubleDouble sqrt(DoubleDouble a) {
+  if (a.hi <= 0) return DoubleDouble(std::sqrt(a.hi));
+  double y = std::sqrt(a.hi);
+  return TwoSum(y, (a - TwoProd(y, y)).hi / (2 * y));
+}
+
+DoubleDouble exp(DoubleDouble a) {
+  if (a.hi > 709.8) return std::numeric_limits<double>::infinity();
+  if (a.hi < -745.2) return 0.0;
+  double k = std::nearbyint(a.hi / kLn2.hi);
+  DoubleDouble r = Ldexp(a - kLn2 * k, -10);
+  DoubleDouble term = r;
+  DoubleDouble sum = r;
+  for (int n = 2; std::fabs(term.hi) > kEpsilon; n++) {
+    term = term * r / DoubleDouble(n);
+    sum = sum + term;
+  }
+  for (int i = 0; i < 10; i++) sum = Ldexp(sum, 1) + sum * sum;
+  return Ldexp(sum + 1.0, static_cast<int>(k));
+}
+
+DoubleDouble log(DoubleDouble a) {
+  if (a.hi <= 0 || std::isinf(a.hi)) return DoubleDouble(std::log(a.hi));
+  DoubleDouble y = std::log(a.hi);
+  return y + a * exp(-y) - 1.0;
+}
+
+DoubleDouble log10(DoubleDouble a) { return log(a) / kLn10; }
+
+DoubleDouble sin(DoubleDouble a) {
+  DoubleDouble s, c;
+  SinCos(a, s, c);
+  return s;
+}
+
+DoubleDouble cos(DoubleDouble a) {
+  DoubleDouble s, c;
+  SinCos(a, s, c);
+  return c;
+}
+
+DoubleDouble tan(DoubleDouble a) {
+  DoubleDouble s, c;
+  SinCos(a, s, c);
+  return s / c;
+}
+
+DoubleDouble atan(DoubleDouble a) {
+  if (std::isinf(a.hi)) return a.hi > 0 ? kHalfPi : -kHalfPi;
+  DoubleDouble y = std::atan(a.hi);
+  DoubleDouble s, c;
+  SinCos(y, s, c);
+  return y - (s - a * c) / (c + a * s);
+}
+
+DoubleDouble asin(DoubleDouble a) {
+  if (a == DoubleDouble(1)) return kHalfPi;
+  if (a == DoubleDouble(-1)) return -kHalfPi;
+  return atan(a / sqrt(DoubleDouble(1) - a * a));
+}
+
+DoubleDouble acos(DoubleDouble a) { return kHalfPi - asin(a); }
+
+DoubleDouble pow(DoubleDouble a, DoubleDouble b) {
+  DoubleDouble res = 1;
+  // A zero base goes first: 1 / 0 would be NaN in double-double, from the
+  // 0 * inf of its residual. std::pow gives the signs of zeros and
+  // infinities.
+  if (a.hi == 0) {
+    res = std::pow(a.hi, b.hi);
+  } else if (b == floor(b) && std::fabs(b.hi) < 1024) {
+    DoubleDouble base = a;
+    for (long n = static_cast<long>(std::fabs(b.hi)); n > 0; n /= 2) {
+      if (n % 2) res = res * base;
+      base = base * base;
+    }
+    if (b.hi < 0) res = DoubleDouble(1) / res;
+  } else if (a.hi < 0) {
+    res = std::numeric_limits<double>::quiet_NaN();
+  } else {
+    res = exp(b * log(a));
+  }
+  return res;
+}
+
+DoubleDouble fmod(DoubleDouble a, DoubleDouble b) {
+  return a - b * Trunc(a / b);
+}
+
+}  // namespace numeric
+
+DoubleDouble ToDoubleDouble(std::string_view text) {
+  DoubleDouble res = 0;
+  int exponent = 0;
+  bool fraction = false;
+  std::size_t i = 0;
+
+  for (; i < text.length(); i++) {
+    char c = text[i];
+    if (c == '.') {
+      fraction = true;
+    } else if (c >= '0' && c <= '9') {
+      res = res * 10.0 + static_cast<double>(c - '0');
+      if (fraction) exponent--;
+    } else {
+      break;
+    }
+  }
+  if (i < text.length() && text[i] == 'E') {
+    bool negative = ++i < text.length() && text[i] == '-';
+    int power = 0;
+    if (i < text.length() && (text[i] == '+' || text[i] == '-')) i++;
+    for (; i < text.length() && text[i] >= '0' && text[i] <= '9'; i++)
+      power = std::min(power * 10 + (text[i] - '0'), 100000);
+    exponent += negative ? -power : power;
+  }
+  if (res.hi == 0) return res;
+  DoubleDouble scale = numeric::pow(DoubleDouble(10), std::abs(exponent));
+  res = exponent < 0 ? res / scale : res * scale;
+  // Overflow and underflow end up as nan in the error terms.
+  if (std::isnan(res.hi))
+    res = exponent < 0 ? 0.0 : std::numeric_limits<double>::infinity();
+  return res;
+}
+
+std::string ToString(DoubleDouble value, int digits) {
+  if (std::isnan(value.hi)) return "nan";
+  if (std::isinf(value.hi)) return value.hi > 0 ? "inf" : "-inf";
+  if (value.hi == 0) return "0";
+
+  std::string sign = value.hi < 0 ? "-" : "";
+  value = Abs(value);
+  int exponent = static_cast<int>(std::floor(std::log10(value.hi)));
+  DoubleDouble mantissa = value / numeric::pow(DoubleDouble(10), exponent);
+  if (mantissa.hi >= 10) {
+    mantissa = mantissa / 10.0;
+    exponent++;
+  } else if (mantissa.hi < 1) {
+    mantissa = mantissa * 10.0;
+    exponent--;
+  }
+
+  std::string res(digits + 1, '0');
+  for (int i = 0; i <= digits; i++) {
+    int digit = static_cast<int>(mantissa.hi);
+    digit = digit < 0 ? 0 : digit > 9 ? 9 : digit;
+    res[i] = static_cast<char>('0' + digit);
+    mantissa = (mantissa - static_cast<double>(digit)) * 10.0;
+  }
+  bool carry = res[digits] >= '5';
+  res.pop_back();
+  for (int i = digits - 1; carry && i >= 0; i--) {
+    carry = res[i] == '9';
+    res[i] = carry ? '0' : res[i] + 1;
+  }
+  if (carry) {
+    res.insert(res.begin(), '1');
+    res.pop_back();
+    exponent++;
+  }
+
+  if (exponent >= 0 && exponent < digits) {
+    res.insert(exponent + 1, ".");
+  } else if (exponent < 0 && exponent > -6) {
+    res.insert(0, std::string(-exponent, '0'));
+    res.insert(1, ".");
+  } else {
+    res.insert(1, ".");
+    res += (exponent < 0 ? "E-" : "E+") + std::to_string(std::abs(exponent));
+  }
+  if (res.find('E') == std::string::npos) {
+    while (res.back() == '0') res.pop_back();
+    if (res.back() == '.') res.pop_back();
+  }
+  return sign + res;
+}
+
+#ifdef MODEL_HAS_FLOAT128
+std::string ToString(Float128 value, int digits) {
+  char buffer[64];
+  quadmath_snprintf(buffer, sizeof(buffer), "%.*Qg", digits, value);
+  // quadmath follows LC_NUMERIC, which Qt takes from the environment.
+  std::string res = buffer;
+  char point = std::localeconv()->decimal_point[0];
+  if (point != '.' && point != '\0')
+    std::replace(res.begin(), res.end(), point, '.');
+  return res;
+}
+#endif
@@ -0,0 +1,158 @@
+#ifndef NUMERIC_H
+#define NUMERIC_H
+
+#include <cmath>
+#include <string>
+#include <string_view>
+
+// The .pro files define MODEL_FLOAT128 where they link libquadmath.
+#if defined(MODEL_FLOAT128) && defined(__SIZEOF_FLOAT128__) && \
+    !defined(__clang__)
+#define MODEL_HAS_FLOAT128 1
+#include <quadmath.h>
+#endif
+
+// Unevaluated sum of two doubles, hi + lo with |lo| <= ulp(hi) / 2. Gives
+// about 32 significant digits with plain double hardware, so it works on
+// every platform the calculator is built for.
+struct DoubleDouble {
+  double hi = 0;
+  double lo = 0;
+
+  DoubleDouble() {}
+  DoubleDouble(double value) : hi(value) {}
+  DoubleDouble(double high, double low) : hi(high), lo(low) {}
+};
+
+inline DoubleDouble QuickTwoSum(double a, double b) {
+  double s = a + b;
+  return DoubleDouble(s, b - (s - a));
+}
+
+inline DoubleDouble TwoSum(double a, double b) {
+  double s = a + b;
+  double bb = s - a;
+  return DoubleDouble(s, (a - (s - bb)) + (b - bb));
+}
+
+inline DoubleDouble TwoProd(double a, double b) {
+  double p = a * b;
+  return DoubleDouble(p, std::fma(a, b, -p));
+}
+
+inline DoubleDouble operator-(DoubleDouble a) {
+  return DoubleDouble(-a.hi, -a.lo);
+}
+
+inline DoubleDouble operator+(DoubleDouble a, DoubleDouble b) {
+  DoubleDouble s = TwoSum(a.hi, b.hi);
+  DoubleDouble t = TwoSum(a.lo, b.lo);
+  s.lo += t.hi;
+  s = QuickTwoSum(s.hi, s.lo);
+  s.lo += t.lo;
+  return QuickTwoSum(s.hi, s.lo);
+}
+
+inline DoubleDouble operator-(DoubleDouble a, DoubleDouble b) {
+  return a + (-b);
+}
+
+inline DoubleDouble operator*(DoubleDouble a, DoubleDouble b) {
+  DoubleDouble p = TwoProd(a.hi, b.hi);
+  p.lo += a.hi * b.lo + a.lo * b.hi;
+  return QuickTwoSum(p.hi, p.lo);
+}
+
+inline DoubleDouble operator/(DoubleDouble a, DoubleDouble b) {
+  double q1 = a.hi / b.hi;
+  DoubleDouble r = a - b * q1;
+  double q2 = r.hi / b.hi;
+  r = r - b * q2;
+  double q3 = r.hi / b.hi;
+  return QuickTwoSum(q1, q2) + q3;
+}
+
+inline bool operator==(DoubleDouble a, DoubleDouble b) {
+  return a.hi == b.hi && a.lo == b.lo;
+}
+
+inline bool operator<(DoubleDouble a, DoubleDouble b) {
+  return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+}
+
+inline bool operator>(DoubleDouble a, DoubleDouble b) { return b < a; }
+
+#ifdef MODEL_HAS_FLOAT128
+using Float128 = __float128;
+#endif
+
+// Math functions for every evaluator type under the <cmath> names, so a
+// template calls numeric::sin(value) and gets std::sin for double. The
+// double-double versions refine the double result or use reduced Taylor
+// series and are accurate to roughly 1e-31 relative.
+namespace numeric {
+
+using std::acos;
+using std::asin;
+using std::atan;
+using std::cos;
+using std::floor;
+using std::fmod;
+using std::log;
+using std::log10;
+using std::pow;
+using std::sin;
+using std::sqrt;
+using std::tan;
+
+DoubleDouble floor(DoubleDouble a);
+DoubleDouble sqrt(DoubleDouble a);
+DoubleDouble exp(DoubleDouble a);
+DoubleDouble log(DoubleDouble a);
+DoubleDouble log10(DoubleDouble a);
+DoubleDouble sin(DoubleDouble a);
+DoubleDouble cos(DoubleDouble a);
+DoubleDouble tan(DoubleDouble a);
+DoubleDouble asin(DoubleDouble a);
+DoubleDouble acos(DoubleDouble a);
+DoubleDouble atan(DoubleDouble a);
+DoubleDouble pow(DoubleDouble a, DoubleDouble b);
+DoubleDouble fmod(DoubleDouble a, DoubleDouble b);
+
+#ifdef MODEL_HAS_FLOAT128
+inline Float128 sqrt(Float128 a) { return sqrtq(a); }
+inline Float128 log(Float128 a) { return logq(a); }
+inline Float128 log10(Float128 a) { return log10q(a); }
+inline Float128 sin(Float128 a) { return sinq(a); }
+inline Float128 cos(Float128 a) { return cosq(a); }
+inline Float128 tan(Float128 a) { return tanq(a); }
+inline Float128 asin(Float128 a) { return asinq(a); }
+inline Float128 acos(Float128 a) { return acosq(a); }
+inline Float128 atan(Float128 a) { return atanq(a); }
+inline Float128 pow(Float128 a, Float128 b) { return powq(a, b); }
+inline Float128 fmod(Float128 a, Float128 b) { return fmodq(a, b); }
+#endif
+
+// a^n as a chain of multiplications (square and multiply), for the small
+// constant exponents the optimizer turns pow into.
+template <typename T>
+T powi(T a, int n) {
+  T res = 1;
+  for (unsigned k = n < 0 ? -n : n; k != 0; k /= 2) {
+    if (k % 2) res = res * a;
+    a = a * a;
+  }
+  return n < 0 ? T(1) / res : res;
+}
+
+}  // namespace numeric
+
+// Reads a literal ("12.375", "1.5E-3") without rounding it to double first.
+DoubleDouble ToDoubleDouble(std::string_view text);
+// Decimal representation with the given number of significant digits.
+std::string ToString(DoubleDouble value, int digits);
+#ifdef MODEL_HAS_FLOAT128
+std::string ToString(Float128 value, int digits);
+#endif
+
+#endif  // NUMERIC_H
@@ -0,0 +1,289 @@
+#ifndef PRESET_H
+#define PRESET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "model.h"
+
+// Formulas that are fixed when the program is built. Formula parses the
+// calculator's expression grammar at compile time and turns the tree into
+// nested inline calls, so evaluating a preset costs no parsing and the
+// compiler optimizes it like hand-written code:
+//
+//   constexpr char kFreeFall[] = "9.81*x^2/2";
+//   double h = preset::Formula<kFreeFall>::Evaluate(t);
+//   preset::Formula<kFreeFall>::Batch(t, h, count);
+//
+// Results and errors are those of Model::Processing. A malformed formula is
+// a compile error, and so is a literal that could not be read exactly: one
+// with more than 15 or so significant digits or an exponent beyond 22.
+// Functions of constants are left to the compiler to fold.
+namespace preset {
+
+struct Node {
+  Model::Operation operation = Model::None;
+  double value = 0;
+  std::size_t left = 0;
+  std::size_t right = 0;
+};
+
+template <std::size_t N>
+struct Tree {
+  Node nodes[N] = {};
+  std::size_t size = 0;
+  std::size_t root = 0;
+};
+
+constexpr std::size_t Length(const char* text) {
+  std::size_t res = 0;
+  while (text[res] != '\0') res++;
+  return res;
+}
+
+// The shunting-yard parser of Model::BuildTree with fixed-size stacks, as
+// constexpr code needs. Constant arithmetic is folded the way Model::AddNode
+// folds it, and ^0.5 becomes Root.
+template <std::size_t N>
+class Parser {
+ public:
+  constexpr explicit Parser(const char* text) : text_(text) {}
+
+  constexpr Tree<N> Parse() {
+    for (std::size_t index = 0; text_[index] != '\0'; index++) {
+      char c = text_[index];
+      if (c >= '0' && c <= '9') {
+        Push(Model::Number, ReadNumber(index), 0, 0);
+      } else if (c == 'x') {
+        Push(Model::Variable, 0, 0, 0);
+      } else if (c == ')') {
+        while (operators_ > 0 &&
+               operator_[operators_ - 1] != Model::OpenBracket)
+          Reduce();
+        if (operators_ == 0) throw std::invalid_argument("unmatched bracket");
+        operators_--;
+      } else {
+        Model::Operation operation = Lex(index);
+        if (operation == Model::Sub && index > 0 && text_[index - 1] == '(')
+          operation = Model::UnarnMinus;
+        short priority = Priority(operation);
+        if (priority >= 1 && priority <= 3)
+          while (operators_ > 0 && priority <= priority_[operators_ - 1])
+            Reduce();
+        operator_[operators_] = operation;
+        priority_[operators_++] = priority;
+      }
+    }
+    while (operators_ > 0) {
+      if (operator_[operators_ - 1] == Model::OpenBracket)
+        throw std::invalid_argument("unmatched bracket");
+      Reduce();
+    }
+    if (operands_ != 1) throw std::invalid_argument("missing operator");
+    tree_.root = operand_[0];
+    return tree_;
+  }
+
+ private:
+  // Reads the operator or function at index, leaving index on its last
+  // character. Names must be spelled out in full.
+  constexpr Model::Operation Lex(std::size_t& index) {
+    struct Name {
+      const char* text;
+      Model::Operation operation;
+    };
+    constexpr Name kNames[] = {
+        {"(", Model::OpenBracket}, {"+", Model::Add},   {"-", Model::Sub},
+        {"*", Model::Mult},        {"/", Model::Div},   {"^", Model::Pow},
+        {"mod", Model::Mod},       {"ln", Model::Ln},   {"log", Model::Log},
+        {"sin", Model::Sin},       {"cos", Model::Cos}, {"tan", Model::Tan},
+        {"sqrt", Model::Sqrt},     {"asin", Model::Asin},
+        {"acos", Model::Acos},     {"atan", Model::Atan}};
+    for (const Name& name : kNames) {
+      std::size_t length = 0;
+      while (name.text[length] != '\0' &&
+             text_[index + length] == name.text[length])
+        length++;
+      if (name.text[length] == '\0') {
+        index += length - 1;
+        return name.operation;
+      }
+    }
+    throw std::invalid_argument("unknown symbol");
+  }
+
+  static constexpr short Priority(Model::Operation operation) {
+    short res = 4;
+    if (operation == Model::OpenBracket) res = 0;
+    if (operation == Model::Add || operation == Model::Sub) res = 1;
+    if (operation == Model::Mult || operation == Model::Div ||
+        operation == Model::Mod)
+      res = 2;
+    if (operation == Model::Pow) res = 3;
+    if (operation == Model::UnarnMinus) res = 5;
+    return res;
+  }
+
+  static constexpr double PowerOfTen(int exponent) {
+    double res = 1;
+    for (int i = 0; i < exponent; i++) res *= 10;
+    return res;
+  }
+
+  // Mantissa and powers of ten up to 1e22 are exact doubles, so one
+  // multiplication or division rounds correctly, as from_chars does.
+  constexpr double ReadNumber(std::size_t& index) {
+    std::uint64_t mantissa = 0;
+    int exponent = 0;
+    bool fraction = false;
+    for (;; index++) {
+      char c = text_[index];
+      if (c == '.' && fraction)
+        throw std::invalid_argument("incorrect number");
+      if (c == '.') {
+        fraction = true;
+      } else if (c >= '0' && c <= '9') {
+        if (mantissa >= (std::uint64_t(1) << 53) / 10)
+          throw std::invalid_argument("literal has too many digits");
+        mantissa = mantissa * 10 + (c - '0');
+        exponent -= fraction;
+      } else {
+        break;
+      }
+    }
+    if (text_[index] == 'E') {
+      bool negative = text_[++index] == '-';
+      if (text_[index] == '+' || text_[index] == '-') index++;
+      int power = 0;
+      for (; text_[index] >= '0' && text_[index] <= '9'; index++)
+        power = power * 10 + (text_[index] - '0');
+      exponent += negative ? -power : power;
+    }
+    index--;
+    if (exponent > 22 || exponent < -22)
+      throw std::invalid_argument("literal exponent out of range");
+    double value = static_cast<double>(mantissa);
+    return exponent < 0 ? value / PowerOfTen(-exponent)
+                        : value * PowerOfTen(exponent);
+  }
+
+  constexpr void Push(Model::Operation operation, double value,
+                      std::size_t left, std::size_t right) {
+    tree_.nodes[tree_.size] = {operation, value, left, right};
+    operand_[operands_++] = tree_.size++;
+  }
+
+  constexpr void Reduce() {
+    Model::Operation operation = operator_[--operators_];
+    bool binarn = Priority(operation) >= 1 && Priority(operation) <= 3;
+    if (operands_ < (binarn ? 2u : 1u))
+      throw std::invalid_argument("missing operand");
+    std::size_t right = operand_[--operands_];
+    std::size_t left = binarn ? operand_[--operands_] : right;
+    const Node& a = tree_.nodes[left];
+    const Node& b = tree_.nodes[right];
+    bool constant =
+        a.operation == Model::Number && b.operation == Model::Number;
+    if (constant && operation == Model::Add) {
+      Push(Model::Number, a.value + b.value, 0, 0);
+    } else if (constant && operation == Model::Sub) {
+      Push(Model::Number, a.value - b.value, 0, 0);
+    } else if (constant && operation == Model::Mult) {
+      Push(Model::Number, a.value * b.value, 0, 0);
+    } else if (constant && operation == Model::Div && b.value != 0) {
+      Push(Model::Number, a.value / b.value, 0, 0);
+    } else if (constant && operation == Model::UnarnMinus) {
+      Push(Model::Number, a.value * (-1), 0, 0);
+    } else if (operation == Model::Pow && b.operation == Model::Number &&
+               b.value == 0.5) {
+      Push(Model::Root, 0, left, 0);
+    } else {
+      Push(operation, 0, left, right);
+    }
+  }
+
+  const char* text_;
+  Tree<N> tree_;
+  Model::Operation operator_[N] = {};
+  short priority_[N] = {};
+  std::size_t operators_ = 0;
+  std::size_t operand_[N] = {};
+  std::size_t operands_ = 0;
+};
+
+template <const char* kText>
+class Formula {
+ public:
+  static double Evaluate(double x) { return Run<tree_.root>(x); }
+
+  // Same calling convention as Model::ExecuteBatch.
+  static void Batch(const double* x, double* y, std::size_t count) {
+    for (std::size_t i = 0; i < count; i++) y[i] = Run<tree_.root>(x[i]);
+  }
+
+ private:
+  static constexpr std::size_t kSize = Length(kText) + 1;
+  static constexpr Tree<kSize> tree_ = Parser<kSize>(kText).Parse();
+
+  // Operands are evaluated left to right, so a formula with two errors
+  // reports the one Model reports.
+  template <std::size_t I>
+  static double Run(double x) {
+    constexpr Node node = tree_.nodes[I];
+    if constexpr (node.operation == Model::Number) {
+      return node.value;
+    } else if constexpr (node.operation == Model::Variable) {
+      return x;
+    } else if constexpr (node.operation == Model::Add ||
+                         node.operation == Model::Sub ||
+                         node.operation == Model::Mult ||
+                         node.operation == Model::Div ||
+                         node.operation == Model::Mod ||
+                         node.operation == Model::Pow) {
+      double left = Run<node.left>(x);
+      double right = Run<node.right>(x);
+      return Binarn<node.operation>(left, right);
+    } else {
+      return Unarn<node.operation>(Run<node.left>(x));
+    }
+  }
+
+  template <Model::Operation kOperation>
+  static double Binarn(double left, double right) {
+    if constexpr (kOperation == Model::Add) return left + right;
+    if constexpr (kOperation == Model::Sub) return left - right;
+    if constexpr (kOperation == Model::Mult) return left * right;
+    if constexpr (kOperation == Model::Div) {
+      if (right == 0) throw std::invalid_argument("can't divide by zero");
+      return left / right;
+    }
+    if constexpr (kOperation == Model::Mod) return numeric::fmod(left, right);
+    if constexpr (kOperation == Model::Pow) return numeric::pow(left, right);
+  }
+
+  template <Model::Operation kOperation>
+  static double Unarn(double value) {
+    if constexpr (kOperation == Model::Asin || kOperation == Model::Acos)
+      if (value > 1 || value < -1)
+        throw std::invalid_argument(
+            "value in asin or acos must be in range[-1; 1]");
+    if constexpr (kOperation == Model::Sqrt)
+      if (value < 0) throw std::invalid_argument("negative in sqrt");
+    if constexpr (kOperation == Model::Ln) return numeric::log(value);
+    if constexpr (kOperation == Model::Log) return numeric::log10(value);
+    if constexpr (kOperation == Model::Sin) return numeric::sin(value);
+    if constexpr (kOperation == Model::Cos) return numeric::cos(value);
+    if constexpr (kOperation == Model::Tan) return numeric::tan(value);
+    if constexpr (kOperation == Model::Asin) return numeric::asin(value);
+    if constexpr (kOperation == Model::Acos) return numeric::acos(value);
+    if constexpr (kOperation == Model::Atan) return numeric::atan(value);
+    if constexpr (kOperation == Model::Sqrt || kOperation == Model::Root)
+      return numeric::sqrt(value);
+    if constexpr (kOperation == Model::UnarnMinus) return value * (-1);
+  }
+};
+
+}  // namespace preset
+
+#endif  // PRESET_H
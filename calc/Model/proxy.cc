@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "model.h"
+
+// Chebyshev proxies. A program is sampled at the Chebyshev points
+// xmid + xhalf * cos(pi * j / n) of its range and replaced by the series
+// of Chebyshev polynomials through them, which the plot tier sums with
+// Clenshaw's recurrence: two multiplications and two additions per
+// coefficient, whatever the program calls.
+//
+// n starts at kMinDegree and doubles, each time reusing the samples it has,
+// until the upper half of the series falls below the tolerance. The series
+// is then cut to where its tail adds up to half the tolerance and checked at
+// the points halfway between the samples, which catches poles, jumps and
+// anything else a polynomial of that degree cannot follow.
+//
+// This file is compiled like batch.cc, without contraction into fused
+// multiply-adds, so that the recurrence rounds the same on every target.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+const std::size_t kMinDegree = 16;
+const std::size_t kMaxDegree = 512;
+const std::size_t kBlock = 256;
+// Graphs get proxies this close to the largest value on their range, well
+// under a pixel on any screen.
+const double kGraphTolerance = 1e-13;
+// Rough cost of a sample in Clenshaw steps, a quarter of a nanosecond on
+// x86-64: per instruction of a program, and per call of a function on top
+// of that.
+const std::size_t kInstructionCost = 1;
+const std::size_t kFunctionCost = 10;
+
+// f(xmid + xhalf * cos(pi * j / n)) for j = first, first + stride, ...
+// up to n, on the result tier. False if a sample is not finite or the
+// program reports an error there.
+bool Sample(Model& model, const Model::Program& program, double xmid,
+            double xhalf, std::size_t n, std::size_t first,
+            std::size_t stride, std::vector<double>& value) {
+  std::vector<double> x;
+  for (std::size_t j = first; j <= n; j += stride)
+    x.push_back(xmid + xhalf * std::cos(kPi * j / n));
+  value.resize(x.size());
+  try {
+    model.ExecuteBatch(program, x.data(), value.data(), x.size(),
+                       Model::AccuracyResult);
+  } catch (const std::invalid_argument&) {
+    return false;
+  }
+  return std::all_of(value.begin(), value.end(),
+                     [](double v) { return std::isfinite(v); });
+}
+
+// Coefficients of the series through value[j] at the points j of n = size
+// - 1, by the discrete cosine transform. cos(pi * j * k / n) is looked up
+// in a table of the 2n angles it can take.
+std::vector<double> Transform(const std::vector<double>& value) {
+  std::size_t n = value.size() - 1;
+  std::vector<double> cosine(2 * n);
+  for (std::size_t m = 0; m < 2 * n; m++)
+    cosine[m] = std::cos(kPi * m / n);
+  std::vector<double> res(n + 1);
+  for (std::size_t k = 0; k <= n; k++) {
+    double sum = (value[0] + (k % 2 == 0 ? value[n] : -value[n])) / 2;
+    for (std::size_t j = 1; j < n; j++)
+      sum += value[j] * cosine[j * k % (2 * n)];
+    res[k] = sum * 2 / n;
+  }
+  res[0] /= 2;
+  res[n] /= 2;
+  return res;
+}
+
+double Clenshaw(const std::vector<double>& c, double t) {
+  double u = 0;
+  double v = 0;
+  for (std::size_t k = c.size() - 1; k >= 1; k--) {
+    double b = c[k] + 2 * t * u - v;
+    v = u;
+    u = b;
+  }
+  return c[0] + t * u - v;
+}
+
+// Evaluation cost of program per sample in Clenshaw steps.
+std::size_t Cost(const Model::Program& program) {
+  std::size_t res = 0;
+  for (const Model::Instruction& instruction : program.code) {
+    Model::Operation operation = instruction.operation;
+    res += kInstructionCost;
+    if (operation == Model::Ln || operation == Model::Log ||
+        operation == Model::Sin || operation == Model::Cos ||
+        operation == Model::Tan || operation == Model::Asin ||
+        operation == Model::Acos || operation == Model::Atan ||
+        operation == Model::SinCos || operation == Model::CosSin ||
+        operation == Model::Pow || operation == Model::Mod)
+      res += kFunctionCost;
+  }
+  return res;
+}
+
+}  // namespace
+
+// Gives program a proxy on [xmin, xmax] that stays within tolerance times
+// the largest absolute value of the program there, and returns whether it
+// could. Programs with errors or values out of range at the samples, and
+// those that need a degree over kMaxDegree, get none; an error between the
+// samples goes unreported by the proxy.
+bool Model::BuildProxy(Program& program, double xmin, double xmax,
+                       double tolerance) {
+  program.proxy = Proxy();
+  if (!(xmin < xmax) || !std::isfinite(xmax - xmin)) return false;
+  double xmid = xmin / 2 + xmax / 2;
+  double xhalf = xmax / 2 - xmin / 2;
+
+  std::vector<double> value;
+  std::vector<double> middle;
+  if (!Sample(*this, program, xmid, xhalf, kMinDegree, 0, 1, value))
+    return false;
+  for (std::size_t n = kMinDegree; n <= kMaxDegree; n *= 2) {
+    // The odd points of 2n lie halfway between those of n.
+    if (!Sample(*this, program, xmid, xhalf, 2 * n, 1, 2, middle))
+      return false;
+    double scale = 0;
+    for (double v : value) scale = std::max(scale, std::fabs(v));
+    for (double v : middle) scale = std::max(scale, std::fabs(v));
+    double limit = tolerance * scale;
+
+    std::vector<double> c = Transform(value);
+    bool converged = std::all_of(c.begin() + n / 2, c.end(),
+                                 [limit](double v) {
+                                   return std::fabs(v) <= limit;
+                                 });
+    if (converged) {
+      // What is cut adds at most its sum to the error.
+      double cut = std::fabs(c.back());
+      while (c.size() > 1 && cut <= limit / 2) {
+        c.pop_back();
+        cut += std::fabs(c.back());
+      }
+      bool close = true;
+      for (std::size_t j = 0; j < n && close; j++) {
+        double t = std::cos(kPi * (2 * j + 1) / (2 * n));
+        close = std::fabs(Clenshaw(c, t) - middle[j]) <= limit;
+      }
+      if (close) {
+        program.proxy = {xmin, xmax, c};
+        return true;
+      }
+    }
+
+    std::vector<double> merged(2 * n + 1);
+    for (std::size_t j = 0; j <= 2 * n; j++)
+      merged[j] = j % 2 == 0 ? value[j / 2] : middle[j / 2];
+    value.swap(merged);
+  }
+  return false;
+}
+
+// Sums the proxy's series for every sample, block by block with the fixed
+// trip counts that let -O2 vectorize, the recurrence unrolled by two so
+// that its two arrays trade places without a copy. Returns false, doing
+// nothing, if there is no proxy or it does not cover all of x.
+bool Model::ExecuteProxy(const Proxy& proxy, const double* x, double* y,
+                         std::size_t count) {
+  const std::vector<double>& c = proxy.coefficients;
+  if (c.empty() || count == 0) return false;
+  bool outside = false;
+  for (std::size_t i = 0; i < count; i++)
+    outside |= x[i] < proxy.xmin || x[i] > proxy.xmax;
+  if (outside) return false;
+  double xmid = proxy.xmin / 2 + proxy.xmax / 2;
+  double scale = 1 / (proxy.xmax / 2 - proxy.xmin / 2);
+
+  alignas(64) double t[kBlock];
+  alignas(64) double twice[kBlock];
+  alignas(64) double u[kBlock];
+  alignas(64) double v[kBlock];
+  for (std::size_t begin = 0; begin < count; begin += kBlock) {
+    std::size_t size = std::min(kBlock, count - begin);
+    std::copy(x + begin, x + begin + size, t);
+    std::fill(t + size, t + kBlock, t[size - 1]);
+    for (std::size_t i = 0; i < kBlock; i++) {
+      t[i] = (t[i] - xmid) * scale;
+      twice[i] = 2 * t[i];
+    }
+    std::fill(u, u + kBlock, 0.0);
+    std::fill(v, v + kBlock, 0.0);
+    // u holds b[k + 1] and v holds b[k + 2] on entry with k = top.
+    std::size_t top = c.size() - 1;
+    for (; top >= 2; top -= 2) {
+      double high = c[top];
+      double low = c[top - 1];
+      for (std::size_t i = 0; i < kBlock; i++)
+        v[i] = high + twice[i] * u[i] - v[i];
+      for (std::size_t i = 0; i < kBlock; i++)
+        u[i] = low + twice[i] * v[i] - u[i];
+    }
+    // Now u holds b[top + 1] and v holds b[top + 2], so b[1] and b[2] are
+    // u and v if top is 0, and one more step away if it is 1.
+    if (top == 1) {
+      double low = c[1];
+      for (std::size_t i = 0; i < kBlock; i++) {
+        double b = low + twice[i] * u[i] - v[i];
+        v[i] = u[i];
+        u[i] = b;
+      }
+    }
+    double first = c[0];
+    for (std::size_t i = 0; i < kBlock; i++)
+      t[i] = first + t[i] * u[i] - v[i];
+    std::copy(t, t + size, y + begin);
+  }
+  return true;
+}
+
+// Graphs that are drawn again over the same range or part of it, as they
+// are when redrawn, zoomed in or animated, reuse a proxy built on the second
+// drawing. It is kept only where it costs less than the program; either way
+// the range is remembered, so that redrawing does not try again.
+void Model::AttachProxy(Program& program, double xmin, double xmax) {
+  bool same = SameCode(program.code, graph_code_);
+  if (!same) {
+    graph_code_ = program.code;
+    graph_proxy_ = Proxy();
+  }
+  if (program.shape.function != None) return;
+  if (same && (xmin < graph_proxy_.xmin || xmax > graph_proxy_.xmax ||
+               graph_proxy_.xmin == graph_proxy_.xmax)) {
+    graph_proxy_ = {xmin, xmax, {}};
+    if (BuildProxy(program, xmin, xmax, kGraphTolerance) &&
+        program.proxy.coefficients.size() < Cost(program))
+      graph_proxy_ = program.proxy;
+  }
+  program.proxy = graph_proxy_;
+}
@@ -0,0 +1,212 @@
+#include "figure.h"
+
+#include <QFileInfo>
+#include <cmath>
+#include <stdexcept>
+
+#include "../qcustomplot.h"
+
+namespace {
+
+// Graphs without a color= of their own take these in turn.
+const char *const kColors[] = {"#1f77b4", "#d62728", "#2ca02c", "#ff7f0e",
+                               "#9467bd", "#8c564b", "#e377c2", "#17becf"};
+const int kMaxSize = 20000;
+
+[[noreturn]] void Fail(const QString &reason) {
+  throw std::invalid_argument(reason.toStdString());
+}
+
+// Splits line at white space outside double quotes, which are dropped.
+QStringList Split(const QString &line) {
+  QStringList res;
+  QString field;
+  bool quoted = false;
+  bool started = false;
+  for (QChar c : line) {
+    if (c == '"') {
+      quoted = !quoted;
+      started = true;
+    } else if (c.isSpace() && !quoted) {
+      if (started) res.append(field);
+      field.clear();
+      started = false;
+    } else {
+      field += c;
+      started = true;
+    }
+  }
+  if (quoted) Fail("unbalanced quotes");
+  if (started) res.append(field);
+  return res;
+}
+
+double ToNumber(const QString &key, const QString &value) {
+  bool ok = false;
+  double res = value.toDouble(&ok);
+  if (!ok || !std::isfinite(res)) Fail("incorrect " + key);
+  return res;
+}
+
+int ToSize(const QString &key, const QString &value) {
+  bool ok = false;
+  int res = value.toInt(&ok);
+  if (!ok || res < 1 || res > kMaxSize) Fail("incorrect " + key);
+  return res;
+}
+
+bool ToFlag(const QString &key, const QString &value) {
+  if (value != "0" && value != "1") Fail(key + " must be 0 or 1");
+  return value == "1";
+}
+
+}  // namespace
+
+Figure ParseFigure(const QString &line) {
+  Figure res;
+  bool ymin = false;
+  bool ymax = false;
+  for (const QString &field : Split(line)) {
+    int equals = int(field.indexOf('='));
+    if (equals <= 0) Fail("expected key=value instead of " + field);
+    QString key = field.left(equals);
+    QString value = field.mid(equals + 1);
+    if (key == "out") {
+      res.output = value;
+    } else if (key == "expr") {
+      res.expressions.append(value);
+    } else if (key == "xmin") {
+      res.xmin = ToNumber(key, value);
+    } else if (key == "xmax") {
+      res.xmax = ToNumber(key, value);
+    } else if (key == "ymin") {
+      res.ymin = ToNumber(key, value);
+      ymin = true;
+    } else if (key == "ymax") {
+      res.ymax = ToNumber(key, value);
+      ymax = true;
+    } else if (key == "width") {
+      res.width = ToSize(key, value);
+    } else if (key == "height") {
+      res.height = ToSize(key, value);
+    } else if (key == "scale") {
+      res.scale = ToNumber(key, value);
+      if (!(res.scale > 0)) Fail("incorrect scale");
+    } else if (key == "color") {
+      if (!QColor(value).isValid()) Fail("incorrect color " + value);
+      res.colors.append(value);
+    } else if (key == "pen") {
+      res.pen = ToNumber(key, value);
+      if (res.pen < 0) Fail("incorrect pen");
+    } else if (key == "dash") {
+      if (value == "solid")
+        res.dash = Qt::SolidLine;
+      else if (value == "dash")
+        res.dash = Qt::DashLine;
+      else if (value == "dot")
+        res.dash = Qt::DotLine;
+      else if (value == "dashdot")
+        res.dash = Qt::DashDotLine;
+      else
+        Fail("dash must be solid, dash, dot or dashdot");
+    } else if (key == "exact") {
+      res.exact = ToFlag(key, value);
+    } else if (key == "part") {
+      res.complex = true;
+      if (value == "re")
+        res.part = Model::PartReal;
+      else if (value == "im")
+        res.part = Model::PartImag;
+      else if (value == "abs")
+        res.part = Model::PartAbs;
+      else
+        Fail("part must be re, im or abs");
+    } else if (key == "grid") {
+      res.grid = ToFlag(key, value);
+    } else if (key == "title") {
+      res.title = value;
+    } else if (key == "xlabel") {
+      res.xlabel = value;
+    } else if (key == "ylabel") {
+      res.ylabel = value;
+    } else {
+      Fail("unknown key " + key);
+    }
+  }
+
+  if (res.output.isEmpty()) Fail("no out");
+  QString suffix = QFileInfo(res.output).suffix().toLower();
+  if (suffix != "pdf" && suffix != "png" && suffix != "jpg" &&
+      suffix != "jpeg" && suffix != "bmp")
+    Fail("out must end in .pdf, .png, .jpg or .bmp");
+  if (res.expressions.isEmpty()) Fail("no expr");
+  if (!(res.xmin < res.xmax)) Fail("xmin must be less than xmax");
+  if (ymin != ymax) Fail("ymin and ymax go together");
+  res.fit = !ymin;
+  if (!res.fit && !(res.ymin < res.ymax)) Fail("ymin must be less than ymax");
+  return res;
+}
+
+// Draws the graphs the way the calculator's window does, on a plot that is
+// never shown, and saves it in the format of the file's suffix. Expressions
+// are read without their spaces, like definitions of user functions, and
+// words the parser would skip, such as exp or abs, are errors.
+void RenderFigure(const Figure &figure, Controller &controller) {
+  QCustomPlot plot;
+  double step = controller.GetCoordinateStep(figure.xmin, figure.xmax);
+  for (int i = 0; i < figure.expressions.size(); i++) {
+    std::string str = QString(figure.expressions[i]).remove(' ').toStdString();
+    if (!controller.HasKnownNames(str))
+      Fail(figure.expressions[i] + ": unknown name");
+    std::vector<double> y;
+    try {
+      y = figure.complex
+              ? controller.GetCoordinateYComplex(str, figure.xmin,
+                                                 figure.xmax, figure.part)
+              : controller.GetCoordinateY(str, figure.xmin, figure.xmax,
+                                          figure.exact ? Model::AccuracyResult
+                                                       : Model::AccuracyPlot);
+    } catch (const std::invalid_argument &e) {
+      Fail(figure.expressions[i] + ": " + e.what());
+    }
+    QSharedPointer<QCPUniformGraphData> data(new QCPUniformGraphData);
+    data->setKeys(figure.xmin, step);
+    data->resize(int(y.size()));
+    data->setValues(0, y.data(), int(y.size()));
+
+    QCPUniformGraph *graph = new QCPUniformGraph(plot.xAxis, plot.yAxis);
+    graph->setData(data);
+    QColor color(i < figure.colors.size()
+                     ? figure.colors[i]
+                     : kColors[i % (sizeof(kColors) / sizeof(kColors[0]))]);
+    graph->setPen(QPen(color, figure.pen, figure.dash));
+  }
+
+  plot.xAxis->setRange(figure.xmin, figure.xmax);
+  if (figure.fit)
+    plot.yAxis->rescale();
+  else
+    plot.yAxis->setRange(figure.ymin, figure.ymax);
+  plot.xAxis->setLabel(figure.xlabel);
+  plot.yAxis->setLabel(figure.ylabel);
+  plot.xAxis->grid()->setVisible(figure.grid);
+  plot.yAxis->grid()->setVisible(figure.grid);
+  if (!figure.title.isEmpty()) {
+    plot.plotLayout()->insertRow(0);
+    plot.plotLayout()->addElement(0, 0,
+                                  new QCPTextElement(&plot, figure.title));
+  }
+
+  const QString &out = figure.output;
+  QString suffix = QFileInfo(out).suffix().toLower();
+  bool saved = false;
+  if (suffix == "pdf")
+    saved = plot.savePdf(out, figure.width, figure.height);
+  else if (suffix == "png")
+    saved = plot.savePng(out, figure.width, figure.height, figure.scale);
+  else if (suffix == "bmp")
+    saved = plot.saveBmp(out, figure.width, figure.height, figure.scale);
+  else
+    saved = plot.saveJpg(out, figure.width, figure.height, figure.scale);
+  if (!saved) Fail("cannot write " + out);
+}
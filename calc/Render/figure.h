@@ -0,0 +1,54 @@
+#ifndef FIGURE_H
+#define FIGURE_H
+
+#include <QColor>
+#include <QString>
+#include <QStringList>
+
+#include "../Controller/controller.h"
+
+// A figure of calc-render, read from a line of key=value fields such as
+//
+//   out=waves.png expr=sin(x) expr=cos(x) xmin=-5 xmax=5 title="Two waves"
+//
+//   out                    file to write, .pdf, .png, .jpg or .bmp
+//   expr                   expression of x, once per graph
+//   xmin, xmax             x range, -10 to 10 by default
+//   ymin, ymax             y range, fitted to the graphs if not given
+//   width, height          size in pixels, 800 by 600 by default
+//   scale                  pixels per unit of width and height in images
+//   color                  colors of the graphs in order, e.g. color=#1f77b4
+//   pen                    line width, 1 by default
+//   dash                   solid, dash, dot or dashdot
+//   exact                  1 to plot like "exact graph"
+//   part                   re, im or abs to plot like "complex"
+//   grid                   0 hides the grid
+//   title, xlabel, ylabel  text; values with spaces go in double quotes
+struct Figure {
+  QString output;
+  QStringList expressions;
+  QStringList colors;
+  double xmin = -10;
+  double xmax = 10;
+  double ymin = 0;
+  double ymax = 0;
+  bool fit = true;
+  int width = 800;
+  int height = 600;
+  double scale = 1;
+  double pen = 1;
+  Qt::PenStyle dash = Qt::SolidLine;
+  bool exact = false;
+  bool complex = false;
+  Model::ComplexPart part = Model::PartReal;
+  bool grid = true;
+  QString title;
+  QString xlabel;
+  QString ylabel;
+};
+
+// Both throw std::invalid_argument with the reason on failure.
+Figure ParseFigure(const QString &line);
+void RenderFigure(const Figure &figure, Controller &controller);
+
+#endif  // FIGURE_H
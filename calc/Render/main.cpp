@@ -0,0 +1,152 @@
+#include <QApplication>
+#include <QFile>
+#include <QProcess>
+#include <QSettings>
+#include <QThread>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "figure.h"
+
+// Renders figures without a window:
+//
+//   calc-render [-j workers] [file ...]
+//
+// Each line of the files, or of the standard input without any, describes a
+// figure (see figure.h); empty lines and lines starting with # are skipped.
+// Widgets live on the main thread only, so figures are rendered in parallel
+// by worker processes: the lines are dealt out to up to workers copies of
+// this program started with --worker, by default one per core. The exit
+// code is 0 if every figure was written, 1 if one failed and 2 for a usage
+// or input error.
+
+namespace {
+
+bool ReadLines(const QStringList &files, QStringList *lines) {
+  QStringList names = files.isEmpty() ? QStringList("-") : files;
+  for (const QString &name : names) {
+    QFile file(name);
+    bool opened = name == "-" ? file.open(stdin, QIODevice::ReadOnly)
+                              : file.open(QIODevice::ReadOnly);
+    if (!opened) {
+      std::fprintf(stderr, "cannot read %s\n", qPrintable(name));
+      return false;
+    }
+    for (const QString &line : QString::fromUtf8(file.readAll()).split('\n')) {
+      QString trimmed = line.trimmed();
+      if (!trimmed.isEmpty() && !trimmed.startsWith('#'))
+        lines->append(trimmed);
+    }
+  }
+  return true;
+}
+
+// Renders lines one after another with the user functions of the
+// calculator's window, which are retried like the window does until a pass
+// defines none, as they may call each other in any order.
+int RenderLines(const QStringList &lines) {
+  Controller controller;
+  QSettings settings;
+  settings.beginGroup("functions");
+  QStringList pending = settings.childKeys();
+  for (bool defined = true; defined && !pending.isEmpty();) {
+    defined = false;
+    for (const QString &key : QStringList(pending)) {
+      std::string definition = settings.value(key).toString().toStdString();
+      if (controller.DefineFunction(definition).empty()) continue;
+      pending.removeOne(key);
+      defined = true;
+    }
+  }
+  for (const QString &key : pending)
+    std::fprintf(stderr, "cannot define saved function %s\n", qPrintable(key));
+  settings.endGroup();
+
+  int res = 0;
+  for (const QString &line : lines) {
+    try {
+      RenderFigure(ParseFigure(line), controller);
+    } catch (const std::invalid_argument &e) {
+      std::fprintf(stderr, "%s: %s\n", qPrintable(line), e.what());
+      res = 1;
+    }
+  }
+  return res;
+}
+
+// Line i goes to worker i % workers, so that neighbouring lines, which tend
+// to cost alike, end up on different workers. QProcess only buffers what is
+// written until the event loop runs, so each worker is handed its whole
+// input before the next one is started; otherwise they would all wait for
+// their lines until the first waitForFinished and run one after another.
+int RunWorkers(const QStringList &lines, int workers) {
+  std::vector<std::unique_ptr<QProcess>> processes;
+  for (int w = 0; w < workers; w++) {
+    QByteArray input;
+    for (int i = w; i < lines.size(); i += workers)
+      input += lines[i].toUtf8() + '\n';
+    processes.emplace_back(new QProcess);
+    QProcess &process = *processes.back();
+    process.setProcessChannelMode(QProcess::ForwardedChannels);
+    process.start(QCoreApplication::applicationFilePath(),
+                  QStringList("--worker"));
+    if (!process.waitForStarted(-1)) continue;
+    process.write(input);
+    while (process.bytesToWrite() > 0 && process.waitForBytesWritten(-1)) {
+    }
+    process.closeWriteChannel();
+  }
+
+  int res = 0;
+  for (const std::unique_ptr<QProcess> &process : processes) {
+    if (!process->waitForFinished(-1) ||
+        process->exitStatus() != QProcess::NormalExit) {
+      std::fprintf(stderr, "worker failed: %s\n",
+                   qPrintable(process->errorString()));
+      res = qMax(res, 1);
+    } else {
+      res = qMax(res, process->exitCode());
+    }
+  }
+  return res;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  QApplication a(argc, argv);
+  QCoreApplication::setOrganizationName("ket03");
+  QCoreApplication::setApplicationName("EngineeringCalculator");
+
+  bool worker = false;
+  int workers = QThread::idealThreadCount();
+  QStringList files;
+  QStringList arguments = a.arguments().mid(1);
+  for (int i = 0; i < arguments.size(); i++) {
+    if (arguments[i] == "--worker") {
+      worker = true;
+    } else if (arguments[i] == "-j" && i + 1 < arguments.size()) {
+      bool ok = false;
+      workers = arguments[++i].toInt(&ok);
+      if (!ok || workers < 1) {
+        std::fprintf(stderr, "-j needs a number of workers\n");
+        return 2;
+      }
+    } else if (arguments[i].startsWith('-') && arguments[i] != "-") {
+      std::fprintf(stderr, "usage: calc-render [-j workers] [file ...]\n");
+      return 2;
+    } else {
+      files.append(arguments[i]);
+    }
+  }
+
+  QStringList lines;
+  if (!ReadLines(files, &lines)) return 2;
+  workers = qMin(workers, int(lines.size()));
+  if (worker || workers <= 1) return RenderLines(lines);
+  return RunWorkers(lines, workers);
+}
@@ -0,0 +1,43 @@
+QT       += core gui printsupport
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+# Command line tool, run on the offscreen platform; no bundle on macOS.
+TARGET = calc-render
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# Same as calc.pro, for Model/kernels.cc.
+gcc|clang: QMAKE_CXXFLAGS += -fno-math-errno -fno-trapping-math
+
+SOURCES += \
+    ../Controller/controller.cc \
+    ../Model/batch.cc \
+    ../Model/export.cc \
+    ../Model/grid.cc \
+    ../Model/jit.cc \
+    ../Model/kernels.cc \
+    ../Model/model.cc \
+    ../Model/numeric.cc \
+    ../Model/proxy.cc \
+    ../Model/table.cc \
+    ../qcustomplot.cpp \
+    figure.cpp \
+    main.cpp
+
+HEADERS += \
+    ../Controller/controller.h \
+    ../Model/jit.h \
+    ../Model/kernels.h \
+    ../Model/model.h \
+    ../Model/numeric.h \
+    ../Model/preset.h \
+    ../qcustomplot.h \
+    figure.h
+
+# __float128 evaluation (Model/numeric.h) needs libquadmath, which only GCC
+# has and only on x86, also for MinGW and GCC on macOS.
+gcc:!clang:contains(QT_ARCH, i386|x86_64) {
+    DEFINES += MODEL_FLOAT128
+    LIBS += -lquadmath
+}
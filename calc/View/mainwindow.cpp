@@ -1,11 +1,41 @@
 #include "mainwindow.h"
 
+#include <QFile>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QSettings>
+
 #include "ui_mainwindow.h"
 
+namespace {
+
+// Writes the values straight into the graph's data, whose keys are the
+// grid's own xmin + i * step and are not stored.
+class GraphSink : public Model::Sink {
+ public:
+  explicit GraphSink(QCPUniformGraphData *data) : data_(data) {}
+
+  void Resize(std::size_t count) override { data_->resize(int(count)); }
+
+  void Write(std::size_t index, const double *, const double *y,
+             std::size_t count) override {
+    data_->setValues(int(index), y, int(count));
+  }
+
+ private:
+  QCPUniformGraphData *data_;
+};
+
+}  // namespace
+
 MainWindow::MainWindow(QWidget *parent)
-    : QMainWindow(parent), ui(new Ui::MainWindow) {
-  setlocale(LC_NUMERIC, "C");
+    : QMainWindow(parent),
+      ui(new Ui::MainWindow),
+      graph_data_(new QCPUniformGraphData) {
   ui->setupUi(this);
+  QCPUniformGraph *graph =
+      new QCPUniformGraph(ui->widget->xAxis, ui->widget->yAxis);
+  graph->setData(graph_data_);
   connect(ui->number_0, SIGNAL(clicked()), this, SLOT(InputNumbers()));
   connect(ui->number_1, SIGNAL(clicked()), this, SLOT(InputNumbers()));
   connect(ui->number_2, SIGNAL(clicked()), this, SLOT(InputNumbers()));
@@ -56,6 +86,48 @@ MainWindow::MainWindow(QWidget *parent)
   connect(ui->button_clear, SIGNAL(clicked()), this, SLOT(Clear()));
   connect(ui->button_equal, SIGNAL(clicked()), this, SLOT(Equal()));
   connect(ui->button_build_graph, SIGNAL(clicked()), this, SLOT(BuildGraph()));
+  connect(ui->button_define, SIGNAL(clicked()), this, SLOT(DefineFunction()));
+  connect(ui->button_remove, SIGNAL(clicked()), this, SLOT(RemoveFunction()));
+  connect(ui->button_export, SIGNAL(clicked()), this, SLOT(ExportCpp()));
+  connect(ui->functions_box, SIGNAL(activated(int)), this,
+          SLOT(InputFunction(int)));
+  connect(ui->expression_line, SIGNAL(textChanged(QString)), this,
+          SLOT(Preview()));
+
+  // Keys come in alphabetical order and a function may call one stored after
+  // it, so the definitions are retried until a pass defines none of them.
+  QSettings settings;
+  settings.beginGroup("functions");
+  QStringList pending = settings.childKeys();
+  for (bool defined = true; defined && !pending.isEmpty();) {
+    defined = false;
+    for (const QString &key : QStringList(pending)) {
+      QString definition = settings.value(key).toString();
+      QString name = QString::fromStdString(
+          controller_.DefineFunction(definition.toStdString()));
+      if (name.isEmpty()) continue;
+      pending.removeOne(key);
+      defined = true;
+      // Older versions kept the spaces of the name in the key.
+      if (name != key) {
+        settings.remove(key);
+        settings.setValue(name, definition);
+      }
+    }
+  }
+  for (const QString &key : pending)
+    qWarning("cannot define saved function %s", qPrintable(key));
+  settings.endGroup();
+  UpdateFunctions();
+
+  ui->precision_box->addItem("double", Model::PrecisionDouble);
+  ui->precision_box->addItem("double-double", Model::PrecisionDoubleDouble);
+  if (Model::HasPrecision(Model::PrecisionFloat128))
+    ui->precision_box->addItem("float128", Model::PrecisionFloat128);
+
+  ui->part_box->addItem("Re", Model::PartReal);
+  ui->part_box->addItem("Im", Model::PartImag);
+  ui->part_box->addItem("|z|", Model::PartAbs);
 
   ui->xmin_spinbox->setValue(-10);
   ui->xmax_spinbox->setValue(10);
@@ -202,13 +274,30 @@ void MainWindow::InputUnarnPlusOrMinus() {
 
 void MainWindow::Clear() { ui->expression_line->setText(""); }
 
+QString MainWindow::ComplexToString(std::complex<double> value) {
+  QString res = QString::number(value.real(), 'f', 7);
+  if (value.imag() != 0)
+    res += (value.imag() < 0 ? "-" : "+") +
+           QString::number(std::fabs(value.imag()), 'f', 7) + "i";
+  return res;
+}
+
 void MainWindow::Equal() {
   std::string str = ui->expression_line->text().toStdString();
   double x = ui->x_input->value();
+  auto precision =
+      Model::Precision(ui->precision_box->currentData().toInt());
 
   if (controller_.Validate(str)) try {
-      ui->result_line->setText(
-          QString::number(controller_.Calculate(str, x), 'f', 7));
+      if (ui->complex_box->isChecked())
+        ui->result_line->setText(ComplexToString(
+            controller_.CalculateComplex(str, x)));
+      else if (precision == Model::PrecisionDouble)
+        ui->result_line->setText(
+            QString::number(controller_.Calculate(str, x), 'f', 7));
+      else
+        ui->result_line->setText(QString::fromStdString(
+            controller_.CalculateExtended(str, x, precision)));
       ui->expression_line->setText("");
     } catch (const std::invalid_argument &e) {
       message.setText(e.what());
@@ -218,9 +307,23 @@ void MainWindow::Equal() {
     ui->result_line->setText("Error in expression");
 }
 
+// Shows the value of the expression while it is typed. Only the part of the
+// expression around the edit is parsed again, so this keeps up with long
+// input. Expressions without a value, and complex ones, leave the line
+// empty; the empty expression that "=" leaves behind keeps its result.
+void MainWindow::Preview() {
+  std::string str = ui->expression_line->text().toStdString();
+  if (str.empty()) return;
+  ui->result_line->clear();
+  if (ui->complex_box->isChecked() || !controller_.Validate(str)) return;
+  try {
+    ui->result_line->setText(QString::number(
+        controller_.Calculate(str, ui->x_input->value()), 'f', 7));
+  } catch (const std::invalid_argument &) {
+  }
+}
+
 void MainWindow::BuildGraph() {
-  QVector<double> x, y;
-  std::vector<double> x_reserve, y_reserve;
   double xmin, xmax, ymin, ymax;
   QString str = ui->expression_line->text();
 
@@ -230,22 +333,111 @@ void MainWindow::BuildGraph() {
     ymin = ui->ymin_spinbox->value();
     ymax = ui->ymax_spinbox->value();
 
-    x_reserve = controller_.GetCoordinateX(xmin, xmax);
-    y_reserve = controller_.GetCoordinateY(str.toStdString(), xmin, xmax);
-    x = QVector<double>(x_reserve.begin(), x_reserve.end());
-    y = QVector<double>(y_reserve.begin(), y_reserve.end());
+    graph_data_->setKeys(xmin, controller_.GetCoordinateStep(xmin, xmax));
+    GraphSink sink(graph_data_.data());
+    try {
+      if (ui->complex_box->isChecked()) {
+        std::vector<double> x = controller_.GetCoordinateX(xmin, xmax);
+        std::vector<double> y = controller_.GetCoordinateYComplex(
+            str.toStdString(), xmin, xmax,
+            Model::ComplexPart(ui->part_box->currentData().toInt()));
+        sink.Resize(x.size());
+        sink.Write(0, x.data(), y.data(), x.size());
+      } else {
+        controller_.GetCoordinates(str.toStdString(), xmin, xmax,
+                                   ui->exact_box->isChecked()
+                                       ? Model::AccuracyResult
+                                       : Model::AccuracyPlot,
+                                   sink);
+      }
+    } catch (const std::invalid_argument &e) {
+      graph_data_->clear();
+      message.setText(e.what());
+      message.exec();
+      return;
+    }
 
-    ui->widget->addGraph();
-    ui->widget->graph(0)->setLineStyle(QCPGraph::lsLine);
-    ui->widget->graph(0)->addData(x, y);
     ui->widget->xAxis->setRange(xmin, xmax);
     ui->widget->yAxis->setRange(ymin, ymax);
     ui->widget->replot();
-    x.clear();
-    y.clear();
-    ui->widget->graph(0)->data()->clear();
   } else {
     message.setText("Need X");
     message.exec();
   }
 }
+
+void MainWindow::DefineFunction() {
+  QString definition = ui->function_line->text();
+
+  std::string name = controller_.DefineFunction(definition.toStdString());
+  if (!name.empty()) {
+    QSettings settings;
+    settings.beginGroup("functions");
+    settings.setValue(QString::fromStdString(name), definition);
+    settings.endGroup();
+    ui->function_line->setText("");
+    UpdateFunctions();
+  } else {
+    message.setText("Definition must look like g(t)=t^2+sin(t)");
+    message.exec();
+  }
+}
+
+void MainWindow::RemoveFunction() {
+  QString name = ui->functions_box->currentData().toString();
+
+  if (name.isEmpty()) return;
+  if (controller_.RemoveFunction(name.toStdString())) {
+    QSettings settings;
+    settings.beginGroup("functions");
+    settings.remove(name);
+    settings.endGroup();
+    UpdateFunctions();
+  } else {
+    message.setText("Other functions call " + name);
+    message.exec();
+  }
+}
+
+// Saves the expression as a C++ header. The file name, without extension,
+// becomes the function name.
+void MainWindow::ExportCpp() {
+  std::string str = ui->expression_line->text().toStdString();
+  if (!controller_.Validate(str)) {
+    ui->result_line->setText("Error in expression");
+    return;
+  }
+  QString file_name = QFileDialog::getSaveFileName(
+      this, "Export C++", "expression.h", "C++ header (*.h)");
+  if (file_name.isEmpty()) return;
+
+  try {
+    std::string code = controller_.ExportCpp(
+        str, QFileInfo(file_name).completeBaseName().toStdString());
+    QFile file(file_name);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text) ||
+        file.write(code.c_str()) < 0) {
+      message.setText("Can't write " + file_name);
+      message.exec();
+    }
+  } catch (const std::invalid_argument &e) {
+    message.setText(e.what());
+    message.exec();
+  }
+}
+
+void MainWindow::InputFunction(int index) {
+  QString expression = ui->expression_line->text();
+  QString name = ui->functions_box->itemData(index).toString();
+
+  if (!expression.endsWith(")") && !IsDigit() && !expression.endsWith(".") &&
+      !expression.endsWith("x") && !expression.endsWith("E"))
+    ui->expression_line->setText(expression + name + "(");
+}
+
+void MainWindow::UpdateFunctions() {
+  ui->functions_box->clear();
+  for (const auto &function : controller_.GetFunctions())
+    ui->functions_box->addItem(QString::fromStdString(function.second),
+                               QString::fromStdString(function.first));
+}
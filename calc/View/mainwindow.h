@@ -23,9 +23,13 @@ class MainWindow : public QMainWindow {
 
 
  private:
+  QString ComplexToString(std::complex<double> value);
+
   Ui::MainWindow *ui;
   Controller controller_;
   QMessageBox message;
+  // Points of the graph, kept from one build to the next for their memory.
+  QSharedPointer<QCPUniformGraphData> graph_data_;
 
  private slots:
   void InputX();
@@ -36,12 +40,18 @@ class MainWindow : public QMainWindow {
   void InputE();
   void Clear();
   void Equal();
+  void Preview();
   bool CanPlaceCloseBracket();
   bool IsBinarn();
   bool IsDigit();
   bool IsZero();
   bool HasDot();
   void BuildGraph();
+  void DefineFunction();
+  void RemoveFunction();
+  void ExportCpp();
+  void InputFunction(int index);
+  void UpdateFunctions();
 };
 
 #endif  // MAINWINDOW_H
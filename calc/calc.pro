@@ -4,23 +4,46 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG += c++17
 
+# Lets the compiler if-convert and vectorize the loops in Model/kernels.cc.
+# Nothing in the app reads errno or enables floating point traps.
+gcc|clang: QMAKE_CXXFLAGS += -fno-math-errno -fno-trapping-math
+
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
     Controller/controller.cc \
+    Model/batch.cc \
+    Model/export.cc \
+    Model/grid.cc \
+    Model/jit.cc \
+    Model/kernels.cc \
     Model/model.cc \
+    Model/numeric.cc \
+    Model/proxy.cc \
+    Model/table.cc \
     View/mainwindow.cpp \
     qcustomplot.cpp \
     main.cpp
 
 HEADERS += \
     Controller/controller.h \
+    Model/jit.h \
+    Model/kernels.h \
     Model/model.h \
+    Model/numeric.h \
+    Model/preset.h \
     View/mainwindow.h \
     qcustomplot.h
 
+# __float128 evaluation (Model/numeric.h) needs libquadmath, which only GCC
+# has and only on x86, also for MinGW and GCC on macOS.
+gcc:!clang:contains(QT_ARCH, i386|x86_64) {
+    DEFINES += MODEL_FLOAT128
+    LIBS += -lquadmath
+}
+
 FORMS += \
     View/mainwindow.ui
 
@@ -4,6 +4,8 @@
 
 int main(int argc, char *argv[]) {
   QApplication a(argc, argv);
+  QCoreApplication::setOrganizationName("ket03");
+  QCoreApplication::setApplicationName("EngineeringCalculator");
 
   QFile file(":/prefix/style.css");
   file.open(QFile::ReadOnly);
@@ -1,5 +1,8 @@
 #include "qcustomplot.h"
 
+#include <atomic>
+#include <thread>
+
 QCPVector2D::QCPVector2D() : mX(0), mY(0) {}
 
 QCPVector2D::QCPVector2D(double x, double y) : mX(x), mY(y) {}
@@ -229,6 +232,49 @@ void QCPPaintBufferPixmap::reallocateBuffer() {
   }
 }
 
+QCPPaintBufferImage::QCPPaintBufferImage(const QSize &size,
+                                         double devicePixelRatio)
+    : QCPAbstractPaintBuffer(size, devicePixelRatio) {
+  QCPPaintBufferImage::reallocateBuffer();
+}
+
+QCPPaintBufferImage::~QCPPaintBufferImage() {}
+
+QCPPainter *QCPPaintBufferImage::startPainting() {
+  QCPPainter *result = new QCPPainter(&mBuffer);
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+  result->setRenderHint(QPainter::HighQualityAntialiasing);
+#endif
+  return result;
+}
+
+void QCPPaintBufferImage::draw(QCPPainter *painter) const {
+  if (painter && painter->isActive())
+    painter->drawImage(0, 0, mBuffer);
+  else
+    qDebug() << Q_FUNC_INFO << "invalid or inactive painter passed";
+}
+
+void QCPPaintBufferImage::clear(const QColor &color) { mBuffer.fill(color); }
+
+void QCPPaintBufferImage::reallocateBuffer() {
+  setInvalidated();
+  if (!qFuzzyCompare(1.0, mDevicePixelRatio)) {
+#ifdef QCP_DEVICEPIXELRATIO_SUPPORTED
+    mBuffer = QImage(mSize * mDevicePixelRatio,
+                     QImage::Format_ARGB32_Premultiplied);
+    mBuffer.setDevicePixelRatio(mDevicePixelRatio);
+#else
+    qDebug() << Q_FUNC_INFO
+             << "Device pixel ratios not supported for Qt versions before 5.4";
+    mDevicePixelRatio = 1.0;
+    mBuffer = QImage(mSize, QImage::Format_ARGB32_Premultiplied);
+#endif
+  } else {
+    mBuffer = QImage(mSize, QImage::Format_ARGB32_Premultiplied);
+  }
+}
+
 #ifdef QCP_OPENGL_PBUFFER
 
 QCPPaintBufferGlPbuffer::QCPPaintBufferGlPbuffer(const QSize &size,
@@ -451,9 +497,11 @@ void QCPLayer::draw(QCPPainter *painter) {
   }
 }
 
-void QCPLayer::drawToPaintBuffer() {
+void QCPLayer::drawToPaintBuffer(bool guiThread) {
   if (QSharedPointer<QCPAbstractPaintBuffer> pb = mPaintBuffer.toStrongRef()) {
     if (QCPPainter *painter = pb->startPainting()) {
+      // Tick label caches hold pixmaps, which only the GUI thread may create.
+      if (!guiThread) painter->setMode(QCPPainter::pmNoCaching);
       if (painter->isActive())
         draw(painter);
       else
@@ -4461,6 +4509,51 @@ double QCPAxis::coordToPixel(double value) const {
   }
 }
 
+// coordToPixel() of count coordinates coordStride doubles apart, written
+// pixelStride doubles apart to pixels. The scale and offset are taken once,
+// so the linear pass vectorizes and the logarithmic one costs a single log
+// per coordinate.
+void QCPAxis::coordToPixel(const double *coords, double *pixels, int count,
+                           int coordStride, int pixelStride) const {
+  const bool horizontal = orientation() == Qt::Horizontal;
+  const double start = horizontal ? mAxisRect->left() : mAxisRect->bottom();
+  double extent = horizontal ? mAxisRect->width() : -mAxisRect->height();
+  if (mRangeReversed) extent = -extent;
+
+  if (mScaleType == stLinear) {
+    const double origin = mRangeReversed ? mRange.upper : mRange.lower;
+    const double scale = extent / mRange.size();
+    if (coordStride == 1 && pixelStride == 1) {
+      for (int i = 0; i < count; ++i)
+        pixels[i] = (coords[i] - origin) * scale + start;
+    } else if (coordStride == 2 && pixelStride == 2) {
+      for (int i = 0; i < count; ++i)
+        pixels[i * 2] = (coords[i * 2] - origin) * scale + start;
+    } else {
+      for (int i = 0; i < count; ++i)
+        pixels[i * pixelStride] =
+            (coords[i * coordStride] - origin) * scale + start;
+    }
+    return;
+  }
+
+  // Coordinates on the other side of zero from the range go past its ends.
+  double low = horizontal ? mAxisRect->left() - 200 : mAxisRect->bottom() + 200;
+  double high = horizontal ? mAxisRect->right() + 200 : mAxisRect->top() - 200;
+  if (mRangeReversed) qSwap(low, high);
+  const bool negative = mRange.upper < 0;
+  const double origin =
+      qLn(qAbs(mRangeReversed ? mRange.upper : mRange.lower));
+  const double scale = extent / qLn(mRange.upper / mRange.lower);
+  for (int i = 0; i < count; ++i) {
+    const double value = coords[i * coordStride];
+    if (negative ? value >= 0 : value <= 0)
+      pixels[i * pixelStride] = negative ? high : low;
+    else
+      pixels[i * pixelStride] = (qLn(qAbs(value)) - origin) * scale + start;
+  }
+}
+
 QCPAxis::SelectablePart QCPAxis::getPartAt(const QPointF &pos) const {
   if (!mVisible) return spNone;
 
@@ -6652,6 +6745,7 @@ QCustomPlot::QCustomPlot(QWidget *parent)
       mSelectionRectMode(QCP::srmNone),
       mSelectionRect(nullptr),
       mOpenGl(false),
+      mRenderThreads(1),
       mMouseHasMoved(false),
       mMouseEventLayerable(nullptr),
       mMouseSignalLayerable(nullptr),
@@ -6893,6 +6987,35 @@ void QCustomPlot::setOpenGl(bool enabled, int multisampling) {
 #endif
 }
 
+/*!
+  Sets how many threads draw the paint buffers on a replot. With more than one,
+  the paint buffers are QImages instead of QPixmaps, and each layer in
+  \ref QCPLayer::lmBuffered mode is drawn on one of up to \a threads - 1 worker
+  threads while the calling thread draws the logical layers.
+
+  Only buffered layers are drawn in parallel. In the default setup that is the
+  "overlay" layer alone, so more threads by themselves gain nothing. To
+  draw the grid, the graphs and the overlays concurrently, put them on layers
+  of their own (see \ref addLayer and \ref QCPLayerable::setLayer) and set
+  those layers to \ref QCPLayer::lmBuffered.
+
+  \warning Layerables on buffered layers are drawn outside the GUI thread and
+  must not draw QPixmaps. This rules out \ref QCPScatterStyle::ssPixmap
+  scatters, \ref QCPItemPixmap and the legend icons of color maps; keep them on
+  logical layers.
+
+  With OpenGL enabled, layers are drawn on the calling thread only.
+*/
+void QCustomPlot::setRenderThreads(int threads) {
+  threads = qMax(1, threads);
+  const bool recreate = (threads > 1) != (mRenderThreads > 1);
+  mRenderThreads = threads;
+  if (recreate) {
+    mPaintBuffers.clear();
+    setupPaintBuffers();
+  }
+}
+
 void QCustomPlot::setViewport(const QRect &rect) {
   mViewport = rect;
   if (mPlotLayout) mPlotLayout->setOuterRect(mViewport);
@@ -7388,7 +7511,7 @@ void QCustomPlot::replot(QCustomPlot::RefreshPriority refreshPriority) {
   updateLayout();
 
   setupPaintBuffers();
-  foreach (QCPLayer *layer, mLayers) layer->drawToPaintBuffer();
+  drawPaintBuffers();
   foreach (QSharedPointer<QCPAbstractPaintBuffer> buffer, mPaintBuffers)
     buffer->setInvalidated(false);
 
@@ -7801,10 +7924,47 @@ QCPAbstractPaintBuffer *QCustomPlot::createPaintBuffer() {
            "shouldn't have happened. Falling back to pixmap paint buffer.";
     return new QCPPaintBufferPixmap(viewport().size(), mBufferDevicePixelRatio);
 #endif
-  } else
+  } else if (mRenderThreads > 1)
+    return new QCPPaintBufferImage(viewport().size(), mBufferDevicePixelRatio);
+  else
     return new QCPPaintBufferPixmap(viewport().size(), mBufferDevicePixelRatio);
 }
 
+// Layers in lmBuffered mode have a paint buffer of their own. With more than
+// one render thread those buffers are images, and the buffered layers are
+// drawn on up to mRenderThreads - 1 worker threads while this one draws the
+// logical layers, which share buffers and may draw pixmaps; setRenderThreads()
+// says what layerables on buffered layers may do. Graphs bring their
+// level-of-detail pyramids up to date while drawing, and a graph may be read
+// from other layers, as channel fills do, so the pyramids of all graphs are
+// brought up to date here before the workers start.
+void QCustomPlot::drawPaintBuffers() {
+  QList<QCPLayer *> buffered;
+  if (mRenderThreads > 1 && !mOpenGl) {
+    foreach (QCPLayer *layer, mLayers) {
+      if (layer->mode() == QCPLayer::lmBuffered) buffered.append(layer);
+    }
+  }
+  if (!buffered.isEmpty()) {
+    foreach (QCPGraph *graph, mGraphs) graph->updateLevels();
+  }
+
+  std::atomic<int> next(0);
+  auto drawBuffered = [&buffered, &next]() {
+    for (int i = next++; i < buffered.size(); i = next++)
+      buffered.at(i)->drawToPaintBuffer(false);
+  };
+  std::vector<std::thread> workers;
+  for (int t = 0; t < qMin(mRenderThreads - 1, int(buffered.size())); ++t)
+    workers.emplace_back(drawBuffered);
+  foreach (QCPLayer *layer, mLayers) {
+    if (buffered.isEmpty() || layer->mode() != QCPLayer::lmBuffered)
+      layer->drawToPaintBuffer();
+  }
+  drawBuffered();
+  for (std::thread &worker : workers) worker.join();
+}
+
 bool QCustomPlot::hasInvalidatedPaintBuffers() {
   foreach (QSharedPointer<QCPAbstractPaintBuffer> buffer, mPaintBuffers) {
     if (buffer->invalidated()) return true;
@@ -8233,6 +8393,31 @@ void QCPColorGradient::setNanColor(const QColor &color) { mNanColor = color; }
 
 void QCPColorGradient::setPeriodic(bool enabled) { mPeriodic = enabled; }
 
+namespace {
+
+const int kMinThreadCells = 1 << 16;
+
+// colorize() on a linear, non-periodic scale in one pass that clamps the
+// position before it truncates it, NaN to the lowest color. True if any
+// value was NaN or infinite.
+bool qcpColorizeLinear(const double *data, int dataIndexFactor, int n,
+                       double lower, double posToIndexFactor,
+                       const QVector<QRgb> &colorBuffer, QRgb *scanLine) {
+  const QRgb *colors = colorBuffer.constData();
+  const double top = colorBuffer.size() - 1;
+  double poison = 0;
+  for (int i = 0; i < n; ++i) {
+    double position = (data[dataIndexFactor * i] - lower) * posToIndexFactor;
+    poison += position * 0;
+    position = position > 0 ? position : 0;
+    position = position < top ? position : top;
+    scanLine[i] = colors[int(position)];
+  }
+  return poison != 0;
+}
+
+}  // namespace
+
 void QCPColorGradient::colorize(const double *data, const QCPRange &range,
                                 QRgb *scanLine, int n, int dataIndexFactor,
                                 bool logarithmic) {
@@ -8250,6 +8435,14 @@ void QCPColorGradient::colorize(const double *data, const QCPRange &range,
   const double posToIndexFactor =
       !logarithmic ? (mLevelCount - 1) / range.size()
                    : (mLevelCount - 1) / qLn(range.upper / range.lower);
+  if (!logarithmic && !mPeriodic) {
+    if (qcpColorizeLinear(data, dataIndexFactor, n, range.lower,
+                          posToIndexFactor, mColorBuffer, scanLine) &&
+        !skipNanCheck)
+      for (int i = 0; i < n; ++i)
+        if (std::isnan(data[dataIndexFactor * i])) scanLine[i] = nanRgb();
+    return;
+  }
   for (int i = 0; i < n; ++i) {
     const double value = data[dataIndexFactor * i];
     if (skipNanCheck || !std::isnan(value)) {
@@ -8264,22 +8457,7 @@ void QCPColorGradient::colorize(const double *data, const QCPRange &range,
       }
       scanLine[i] = mColorBuffer.at(index);
     } else {
-      switch (mNanHandling) {
-        case nhLowestColor:
-          scanLine[i] = mColorBuffer.first();
-          break;
-        case nhHighestColor:
-          scanLine[i] = mColorBuffer.last();
-          break;
-        case nhTransparent:
-          scanLine[i] = qRgba(0, 0, 0, 0);
-          break;
-        case nhNanColor:
-          scanLine[i] = mNanColor.rgba();
-          break;
-        case nhNone:
-          break;
-      }
+      scanLine[i] = nanRgb();
     }
   }
 }
@@ -8305,6 +8483,24 @@ void QCPColorGradient::colorize(const double *data, const unsigned char *alpha,
   const double posToIndexFactor =
       !logarithmic ? (mLevelCount - 1) / range.size()
                    : (mLevelCount - 1) / qLn(range.upper / range.lower);
+  if (!logarithmic && !mPeriodic) {
+    const bool poisoned =
+        qcpColorizeLinear(data, dataIndexFactor, n, range.lower,
+                          posToIndexFactor, mColorBuffer, scanLine);
+    for (int i = 0; i < n; ++i) {
+      const unsigned char cellAlpha = alpha[dataIndexFactor * i];
+      if (cellAlpha != 255) {
+        const QRgb rgb = scanLine[i];
+        const float alphaF = cellAlpha / 255.0f;
+        scanLine[i] = qRgba(int(qRed(rgb) * alphaF), int(qGreen(rgb) * alphaF),
+                            int(qBlue(rgb) * alphaF), int(qAlpha(rgb) * alphaF));
+      }
+    }
+    if (poisoned && !skipNanCheck)
+      for (int i = 0; i < n; ++i)
+        if (std::isnan(data[dataIndexFactor * i])) scanLine[i] = nanRgb();
+    return;
+  }
   for (int i = 0; i < n; ++i) {
     const double value = data[dataIndexFactor * i];
     if (skipNanCheck || !std::isnan(value)) {
@@ -8327,45 +8523,33 @@ void QCPColorGradient::colorize(const double *data, const unsigned char *alpha,
                   int(qBlue(rgb) * alphaF), int(qAlpha(rgb) * alphaF));
       }
     } else {
-      switch (mNanHandling) {
-        case nhLowestColor:
-          scanLine[i] = mColorBuffer.first();
-          break;
-        case nhHighestColor:
-          scanLine[i] = mColorBuffer.last();
-          break;
-        case nhTransparent:
-          scanLine[i] = qRgba(0, 0, 0, 0);
-          break;
-        case nhNanColor:
-          scanLine[i] = mNanColor.rgba();
-          break;
-        case nhNone:
-          break;
-      }
+      scanLine[i] = nanRgb();
     }
   }
 }
 
+// The color of NaN cells, for any NaN handling but nhNone.
+QRgb QCPColorGradient::nanRgb() const {
+  switch (mNanHandling) {
+    case nhLowestColor:
+      return mColorBuffer.first();
+    case nhHighestColor:
+      return mColorBuffer.last();
+    case nhNanColor:
+      return mNanColor.rgba();
+    case nhTransparent:
+    case nhNone:
+      break;
+  }
+  return qRgba(0, 0, 0, 0);
+}
+
 QRgb QCPColorGradient::color(double position, const QCPRange &range,
                              bool logarithmic) {
   if (mColorBufferInvalidated) updateColorBuffer();
 
   const bool skipNanCheck = mNanHandling == nhNone;
-  if (!skipNanCheck && std::isnan(position)) {
-    switch (mNanHandling) {
-      case nhLowestColor:
-        return mColorBuffer.first();
-      case nhHighestColor:
-        return mColorBuffer.last();
-      case nhTransparent:
-        return qRgba(0, 0, 0, 0);
-      case nhNanColor:
-        return mNanColor.rgba();
-      case nhNone:
-        return qRgba(0, 0, 0, 0);
-    }
-  }
+  if (!skipNanCheck && std::isnan(position)) return nanRgb();
 
   const double posToIndexFactor =
       !logarithmic ? (mLevelCount - 1) / range.size()
@@ -10544,6 +10728,336 @@ void QCPColorScaleAxisRectPrivate::axisSelectableChanged(
   }
 }
 
+namespace {
+
+const int kColumnLanes = 2;
+const int kColumnBlock = 64;
+const int kMinThreadPoints = 1 << 16;
+
+// Graph data for qcpGetLineData(), from the front of its container.
+struct QCPGraphLineSource {
+  const QCPGraphData *data;
+  const QCPDataLevels *levels;
+  double key(int index) const { return data[index].key; }
+  double value(int index) const { return data[index].value; }
+  int findBegin(double key, int begin, int end) const {
+    return int(std::lower_bound(data + begin, data + end, QCPGraphData(key, 0),
+                                qcpLessThanSortKey<QCPGraphData>) -
+               data);
+  }
+  bool findExtremes(int begin, int end, int *low, int *high) const {
+    return levels->isEnabled() &&
+           levels->findExtremes(*this, begin, end, low, high);
+  }
+};
+
+template <class Source>
+void qcpAppendRun(const Source &source, int first, int low, int high,
+                  int last, QVector<QCPGraphData> *lineData) {
+  const int order[4] = {first, qMin(low, high), qMax(low, high), last};
+  for (int k = 0; k < 4; ++k)
+    if (k == 0 || order[k] != order[k - 1])
+      lineData->append(
+          QCPGraphData(source.key(order[k]), source.value(order[k])));
+}
+
+// The lowest and highest of the points begin .. end - 1 and their sum
+// times 0, which is NaN if any of them is NaN or infinite. The points are
+// copied out of the source kColumnLanes at a time and reduced lane by lane,
+// which -O2 turns into vector min and max.
+template <class Source, class Value>
+void qcpGetExtremes(const Source &source, int begin, int end, Value *lower,
+                    Value *upper, Value *poison) {
+  Value low[kColumnLanes], high[kColumnLanes], sum[kColumnLanes];
+  for (int k = 0; k < kColumnLanes; ++k) {
+    low[k] = high[k] = source.value(begin);
+    sum[k] = 0;
+  }
+  int i = begin;
+  for (; i + kColumnLanes <= end; i += kColumnLanes) {
+    Value block[kColumnLanes];
+    for (int k = 0; k < kColumnLanes; ++k) block[k] = source.value(i + k);
+    for (int k = 0; k < kColumnLanes; ++k) {
+      low[k] = block[k] < low[k] ? block[k] : low[k];
+      high[k] = block[k] > high[k] ? block[k] : high[k];
+      sum[k] += block[k] * 0;
+    }
+  }
+  for (; i < end; ++i) {
+    const Value value = source.value(i);
+    low[0] = value < low[0] ? value : low[0];
+    high[0] = value > high[0] ? value : high[0];
+    sum[0] += value * 0;
+  }
+  *lower = low[0];
+  *upper = high[0];
+  *poison = sum[0];
+  for (int k = 1; k < kColumnLanes; ++k) {
+    *lower = qMin(*lower, low[k]);
+    *upper = qMax(*upper, high[k]);
+    *poison += sum[k];
+  }
+}
+
+// Appends the points begin .. end - 1, all in one pixel column, as the
+// first, lowest, highest and last point of each run between NaNs, which
+// draw the same line. A NaN is kept once, to break it.
+template <class Source>
+void qcpAppendColumn(const Source &source, int begin, int end,
+                     QVector<QCPGraphData> *lineData) {
+  typedef decltype(source.value(begin)) Value;
+  int lowIndex, highIndex;
+  if (end - begin > 2 * kColumnBlock &&
+      source.findExtremes(begin, end, &lowIndex, &highIndex)) {
+    qcpAppendRun(source, begin, lowIndex, highIndex, end - 1, lineData);
+    return;
+  }
+  // The extremes are taken kColumnBlock points at a time, so that only the
+  // blocks that hold them are searched for their index.
+  Value lower = source.value(begin), upper = lower, poison = 0;
+  int lowBlock = begin, highBlock = begin;
+  for (int block = begin; block < end && poison == 0; block += kColumnBlock) {
+    Value blockLower, blockUpper, blockPoison;
+    qcpGetExtremes(source, block, qMin(block + kColumnBlock, end), &blockLower,
+                   &blockUpper, &blockPoison);
+    if (blockLower < lower) {
+      lower = blockLower;
+      lowBlock = block;
+    }
+    if (blockUpper > upper) {
+      upper = blockUpper;
+      highBlock = block;
+    }
+    poison += blockPoison;
+  }
+
+  if (poison == 0) {
+    int low = lowBlock, high = highBlock;
+    while (source.value(low) != lower) ++low;
+    while (source.value(high) != upper) ++high;
+    qcpAppendRun(source, begin, low, high, end - 1, lineData);
+    return;
+  }
+
+  int first = -1, low = -1, high = -1, last = -1;
+  for (int i = begin; i < end; ++i) {
+    const Value value = source.value(i);
+    if (qIsNaN(value)) {
+      if (first >= 0) qcpAppendRun(source, first, low, high, last, lineData);
+      first = -1;
+      if (lineData->isEmpty() || !qIsNaN(lineData->last().value))
+        lineData->append(QCPGraphData(source.key(i), value));
+      continue;
+    }
+    if (first < 0)
+      first = low = high = i;
+    else if (value < source.value(low))
+      low = i;
+    else if (value > source.value(high))
+      high = i;
+    last = i;
+  }
+  if (first >= 0) qcpAppendRun(source, first, low, high, last, lineData);
+}
+
+}  // namespace
+
+// Level l is brought up from the first block that holds a point past the
+// valid ones, level 0 from the points and the others from the two blocks
+// below. Blocks that begin before the front are never read.
+template <class Source>
+void QCPDataLevels::update(const Source &source, int size) const {
+  if (mValid >= size) return;
+  typedef decltype(source.value(0)) Value;
+  const qint64 end = mRemoved + size;
+  int level = 0;
+  for (; (qint64(kColumnBlock) << level) <= size; ++level) {
+    const qint64 span = qint64(kColumnBlock) << level;
+    const qint64 front = mRemoved / span;
+    qint64 from = (mRemoved + mValid) / span;
+    if (level == mLevels.size()) {
+      mLevels.append(QVector<Block>());
+      mFirst.append(front);
+      from = front;
+    }
+    QVector<Block> &blocks = mLevels[level];
+    qint64 &first = mFirst[level];
+    if (front - first > blocks.size() / 2) {
+      blocks.remove(0, int(qMin<qint64>(front - first, blocks.size())));
+      first = front;
+    }
+    blocks.resize(int(end / span - first));
+    for (qint64 j = from; j < end / span; ++j) {
+      Block &block = blocks[int(j - first)];
+      const qint64 start = j * span;
+      if (start < mRemoved) {
+        block.low = block.high = -1;
+      } else if (level == 0) {
+        const int begin = int(start - mRemoved);
+        Value lower, upper, poison;
+        qcpGetExtremes(source, begin, begin + kColumnBlock, &lower, &upper,
+                       &poison);
+        if (poison != 0) {
+          block.low = block.high = -1;
+          continue;
+        }
+        int low = begin, high = begin;
+        while (source.value(low) != lower) ++low;
+        while (source.value(high) != upper) ++high;
+        block.low = low + mRemoved;
+        block.high = high + mRemoved;
+      } else {
+        const qint64 below = 2 * j - mFirst[level - 1];
+        const Block &left = mLevels[level - 1][int(below)];
+        const Block &right = mLevels[level - 1][int(below + 1)];
+        if (left.low < 0 || right.low < 0) {
+          block.low = block.high = -1;
+          continue;
+        }
+        block.low = source.value(int(right.low - mRemoved)) <
+                            source.value(int(left.low - mRemoved))
+                        ? right.low
+                        : left.low;
+        block.high = source.value(int(right.high - mRemoved)) >
+                             source.value(int(left.high - mRemoved))
+                         ? right.high
+                         : left.high;
+      }
+    }
+  }
+  mLevels.resize(level);
+  mFirst.resize(level);
+  mValid = size;
+}
+
+// The first lowest and highest of the points begin .. end - 1 from the
+// largest blocks that fit, and the points at either end one by one. False
+// if any of them is NaN or infinite.
+template <class Source>
+bool QCPDataLevels::findExtremes(const Source &source, int begin, int end,
+                                 int *low, int *high) const {
+  *low = *high = begin;
+  qint64 position = mRemoved + begin;
+  const qint64 last = mRemoved + end;
+  while (position < last) {
+    int level = -1;
+    while (level + 1 < mLevels.size() &&
+           position % (qint64(kColumnBlock) << (level + 1)) == 0 &&
+           position + (qint64(kColumnBlock) << (level + 1)) <= last)
+      ++level;
+    qint64 lowest = position, highest = position;
+    if (level >= 0) {
+      const Block &block = mLevels[level][int(
+          position / (qint64(kColumnBlock) << level) - mFirst[level])];
+      if (block.low < 0) return false;
+      lowest = block.low;
+      highest = block.high;
+      position += qint64(kColumnBlock) << level;
+    } else {
+      if (source.value(int(position - mRemoved)) * 0 != 0) return false;
+      ++position;
+    }
+    if (source.value(int(lowest - mRemoved)) < source.value(*low))
+      *low = int(lowest - mRemoved);
+    if (source.value(int(highest - mRemoved)) > source.value(*high))
+      *high = int(highest - mRemoved);
+  }
+  return true;
+}
+
+namespace {
+
+double qcpKeyColumn(const QCPAxis *keyAxis, double key) {
+  return std::floor(keyAxis->coordToPixel(key));
+}
+
+// M4 decimation of the points begin .. end - 1: each pixel column of
+// keyAxis is found by a search for the key of its edge, settled on the
+// pixels themselves, and reduced by qcpAppendColumn().
+template <class Source>
+void qcpAppendLineData(const Source &source, const QCPAxis *keyAxis,
+                       int begin, int end, QVector<QCPGraphData> *lineData) {
+  const bool increasing = keyAxis->pixelOrientation() > 0;
+  int i = begin;
+  while (i < end) {
+    const double column = qcpKeyColumn(keyAxis, source.key(i));
+    int columnEnd = source.findBegin(
+        keyAxis->pixelToCoord(increasing ? column + 1 : column), i + 1, end);
+    while (columnEnd > i + 1 &&
+           qcpKeyColumn(keyAxis, source.key(columnEnd - 1)) != column)
+      --columnEnd;
+    while (columnEnd < end &&
+           qcpKeyColumn(keyAxis, source.key(columnEnd)) == column)
+      ++columnEnd;
+    qcpAppendColumn(source, i, columnEnd, lineData);
+    i = columnEnd;
+  }
+}
+
+// qcpAppendLineData() into lineData, split at pixel columns over up to
+// threads threads of at least kMinThreadPoints points each.
+template <class Source>
+void qcpGetLineData(const Source &source, const QCPAxis *keyAxis, int begin,
+                    int end, int threads, QVector<QCPGraphData> *lineData) {
+  lineData->clear();
+  threads = qMax(1, qMin(threads, (end - begin) / kMinThreadPoints));
+  QVector<int> starts(threads + 1);
+  starts[0] = begin;
+  starts[threads] = end;
+  for (int t = 1; t < threads; ++t) {
+    int start = qMax(starts[t - 1],
+                     begin + int(qint64(end - begin) * t / threads));
+    while (start > begin && start < end &&
+           qcpKeyColumn(keyAxis, source.key(start)) ==
+               qcpKeyColumn(keyAxis, source.key(start - 1)))
+      ++start;
+    starts[t] = start;
+  }
+
+  QVector<QVector<QCPGraphData> > parts(threads);
+  std::vector<std::thread> workers;
+  for (int t = 1; t < threads; ++t)
+    workers.emplace_back([&, t]() {
+      qcpAppendLineData(source, keyAxis, starts[t], starts[t + 1], &parts[t]);
+    });
+  qcpAppendLineData(source, keyAxis, starts[0], starts[1], lineData);
+  for (std::thread &worker : workers) worker.join();
+  for (int t = 1; t < threads; ++t) *lineData += parts[t];
+}
+
+// Pixels of count data points, the keys along keyAxis, for data types made
+// of doubles only. They are written in place where a QPointF is two doubles,
+// and through a buffer where qreal is float.
+template <class DataType>
+void qcpDataToPixels(const QCPAxis *keyAxis, const QCPAxis *valueAxis,
+                     const DataType *data, QPointF *pixels, int count) {
+  if (count == 0) return;
+  const int stride = int(sizeof(DataType) / sizeof(double));
+  const bool vertical = keyAxis->orientation() == Qt::Vertical;
+  auto transform = [&](double *xy) {
+    keyAxis->coordToPixel(&data->key, xy + (vertical ? 1 : 0), count, stride,
+                          2);
+    valueAxis->coordToPixel(&data->value, xy + (vertical ? 0 : 1), count,
+                            stride, 2);
+  };
+  if (std::is_same<qreal, double>::value &&
+      sizeof(QPointF) == 2 * sizeof(double)) {
+    transform(reinterpret_cast<double *>(pixels));
+  } else {
+    QVector<double> xy(2 * count);
+    transform(xy.data());
+    for (int i = 0; i < count; ++i)
+      pixels[i] = QPointF(xy.at(2 * i), xy.at(2 * i + 1));
+  }
+}
+
+// The pixel with the key of key and the value of value.
+QPointF qcpStepPixel(bool vertical, const QPointF &key, const QPointF &value) {
+  return vertical ? QPointF(value.x(), key.y()) : QPointF(key.x(), value.y());
+}
+
+}  // namespace
+
 QCPGraphData::QCPGraphData() : key(0), value(0) {}
 
 QCPGraphData::QCPGraphData(double key, double value) : key(key), value(value) {}
@@ -10552,7 +11066,8 @@ QCPGraph::QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis)
     : QCPAbstractPlottable1D<QCPGraphData>(keyAxis, valueAxis),
       mLineStyle{},
       mScatterSkip{},
-      mAdaptiveSampling{} {
+      mAdaptiveSampling{},
+      mAdaptiveSamplingThreads{} {
   mParentPlot->registerGraph(this);
 
   setPen(QPen(Qt::blue, 0));
@@ -10562,6 +11077,7 @@ QCPGraph::QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis)
   setScatterSkip(0);
   setChannelFillGraph(nullptr);
   setAdaptiveSampling(true);
+  setAdaptiveSamplingThreads(1);
 }
 
 QCPGraph::~QCPGraph() {}
@@ -10604,6 +11120,18 @@ void QCPGraph::setAdaptiveSampling(bool enabled) {
   mAdaptiveSampling = enabled;
 }
 
+bool QCPGraph::levelOfDetail() const {
+  return mDataContainer->levelOfDetail();
+}
+
+void QCPGraph::setLevelOfDetail(bool enabled) {
+  mDataContainer->setLevelOfDetail(enabled);
+}
+
+void QCPGraph::setAdaptiveSamplingThreads(int threads) {
+  mAdaptiveSamplingThreads = qMax(1, threads);
+}
+
 void QCPGraph::addData(const QVector<double> &keys,
                        const QVector<double> &values, bool alreadySorted) {
   if (keys.size() != values.size())
@@ -10825,21 +11353,10 @@ void QCPGraph::getScatters(QVector<QPointF> *scatters,
     std::reverse(data.begin(), data.end());
 
   scatters->resize(data.size());
-  if (keyAxis->orientation() == Qt::Vertical) {
-    for (int i = 0; i < data.size(); ++i) {
-      if (!qIsNaN(data.at(i).value)) {
-        (*scatters)[i].setX(valueAxis->coordToPixel(data.at(i).value));
-        (*scatters)[i].setY(keyAxis->coordToPixel(data.at(i).key));
-      }
-    }
-  } else {
-    for (int i = 0; i < data.size(); ++i) {
-      if (!qIsNaN(data.at(i).value)) {
-        (*scatters)[i].setX(keyAxis->coordToPixel(data.at(i).key));
-        (*scatters)[i].setY(valueAxis->coordToPixel(data.at(i).value));
-      }
-    }
-  }
+  qcpDataToPixels(keyAxis, valueAxis, data.constData(), scatters->data(),
+                  int(data.size()));
+  for (int i = 0; i < data.size(); ++i)
+    if (qIsNaN(data.at(i).value)) (*scatters)[i] = QPointF();
 }
 
 QVector<QPointF> QCPGraph::dataToLines(
@@ -10853,18 +11370,8 @@ QVector<QPointF> QCPGraph::dataToLines(
   }
 
   result.resize(data.size());
-
-  if (keyAxis->orientation() == Qt::Vertical) {
-    for (int i = 0; i < data.size(); ++i) {
-      result[i].setX(valueAxis->coordToPixel(data.at(i).value));
-      result[i].setY(keyAxis->coordToPixel(data.at(i).key));
-    }
-  } else {
-    for (int i = 0; i < data.size(); ++i) {
-      result[i].setX(keyAxis->coordToPixel(data.at(i).key));
-      result[i].setY(valueAxis->coordToPixel(data.at(i).value));
-    }
-  }
+  qcpDataToPixels(keyAxis, valueAxis, data.constData(), result.data(),
+                  int(data.size()));
   return result;
 }
 
@@ -10878,28 +11385,15 @@ QVector<QPointF> QCPGraph::dataToStepLeftLines(
     return result;
   }
 
+  const bool vertical = keyAxis->orientation() == Qt::Vertical;
+  QVector<QPointF> points(data.size());
+  qcpDataToPixels(keyAxis, valueAxis, data.constData(), points.data(),
+                  int(data.size()));
   result.resize(data.size() * 2);
-
-  if (keyAxis->orientation() == Qt::Vertical) {
-    double lastValue = valueAxis->coordToPixel(data.first().value);
-    for (int i = 0; i < data.size(); ++i) {
-      const double key = keyAxis->coordToPixel(data.at(i).key);
-      result[i * 2 + 0].setX(lastValue);
-      result[i * 2 + 0].setY(key);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
-      result[i * 2 + 1].setX(lastValue);
-      result[i * 2 + 1].setY(key);
-    }
-  } else {
-    double lastValue = valueAxis->coordToPixel(data.first().value);
-    for (int i = 0; i < data.size(); ++i) {
-      const double key = keyAxis->coordToPixel(data.at(i).key);
-      result[i * 2 + 0].setX(key);
-      result[i * 2 + 0].setY(lastValue);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
-      result[i * 2 + 1].setX(key);
-      result[i * 2 + 1].setY(lastValue);
-    }
+  for (int i = 0; i < data.size(); ++i) {
+    result[i * 2 + 0] =
+        qcpStepPixel(vertical, points.at(i), points.at(qMax(0, i - 1)));
+    result[i * 2 + 1] = points.at(i);
   }
   return result;
 }
@@ -10914,28 +11408,15 @@ QVector<QPointF> QCPGraph::dataToStepRightLines(
     return result;
   }
 
+  const bool vertical = keyAxis->orientation() == Qt::Vertical;
+  QVector<QPointF> points(data.size());
+  qcpDataToPixels(keyAxis, valueAxis, data.constData(), points.data(),
+                  int(data.size()));
   result.resize(data.size() * 2);
-
-  if (keyAxis->orientation() == Qt::Vertical) {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    for (int i = 0; i < data.size(); ++i) {
-      const double value = valueAxis->coordToPixel(data.at(i).value);
-      result[i * 2 + 0].setX(value);
-      result[i * 2 + 0].setY(lastKey);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
-      result[i * 2 + 1].setX(value);
-      result[i * 2 + 1].setY(lastKey);
-    }
-  } else {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    for (int i = 0; i < data.size(); ++i) {
-      const double value = valueAxis->coordToPixel(data.at(i).value);
-      result[i * 2 + 0].setX(lastKey);
-      result[i * 2 + 0].setY(value);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
-      result[i * 2 + 1].setX(lastKey);
-      result[i * 2 + 1].setY(value);
-    }
+  for (int i = 0; i < data.size(); ++i) {
+    result[i * 2 + 0] =
+        qcpStepPixel(vertical, points.at(qMax(0, i - 1)), points.at(i));
+    result[i * 2 + 1] = points.at(i);
   }
   return result;
 }
@@ -10950,43 +11431,18 @@ QVector<QPointF> QCPGraph::dataToStepCenterLines(
     return result;
   }
 
+  const bool vertical = keyAxis->orientation() == Qt::Vertical;
+  QVector<QPointF> points(data.size());
+  qcpDataToPixels(keyAxis, valueAxis, data.constData(), points.data(),
+                  int(data.size()));
   result.resize(data.size() * 2);
-
-  if (keyAxis->orientation() == Qt::Vertical) {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    double lastValue = valueAxis->coordToPixel(data.first().value);
-    result[0].setX(lastValue);
-    result[0].setY(lastKey);
-    for (int i = 1; i < data.size(); ++i) {
-      const double key =
-          (keyAxis->coordToPixel(data.at(i).key) + lastKey) * 0.5;
-      result[i * 2 - 1].setX(lastValue);
-      result[i * 2 - 1].setY(key);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
-      result[i * 2 + 0].setX(lastValue);
-      result[i * 2 + 0].setY(key);
-    }
-    result[data.size() * 2 - 1].setX(lastValue);
-    result[data.size() * 2 - 1].setY(lastKey);
-  } else {
-    double lastKey = keyAxis->coordToPixel(data.first().key);
-    double lastValue = valueAxis->coordToPixel(data.first().value);
-    result[0].setX(lastKey);
-    result[0].setY(lastValue);
-    for (int i = 1; i < data.size(); ++i) {
-      const double key =
-          (keyAxis->coordToPixel(data.at(i).key) + lastKey) * 0.5;
-      result[i * 2 - 1].setX(key);
-      result[i * 2 - 1].setY(lastValue);
-      lastValue = valueAxis->coordToPixel(data.at(i).value);
-      lastKey = keyAxis->coordToPixel(data.at(i).key);
-      result[i * 2 + 0].setX(key);
-      result[i * 2 + 0].setY(lastValue);
-    }
-    result[data.size() * 2 - 1].setX(lastKey);
-    result[data.size() * 2 - 1].setY(lastValue);
+  result[0] = points.first();
+  for (int i = 1; i < data.size(); ++i) {
+    const QPointF key = (points.at(i) + points.at(i - 1)) * 0.5;
+    result[i * 2 - 1] = qcpStepPixel(vertical, key, points.at(i - 1));
+    result[i * 2 + 0] = qcpStepPixel(vertical, key, points.at(i));
   }
+  result[data.size() * 2 - 1] = points.last();
   return result;
 }
 
@@ -11000,35 +11456,20 @@ QVector<QPointF> QCPGraph::dataToImpulseLines(
     return result;
   }
 
+  const bool vertical = keyAxis->orientation() == Qt::Vertical;
+  QVector<QPointF> points(data.size());
+  qcpDataToPixels(keyAxis, valueAxis, data.constData(), points.data(),
+                  int(data.size()));
   result.resize(data.size() * 2);
-
-  if (keyAxis->orientation() == Qt::Vertical) {
-    for (int i = 0; i < data.size(); ++i) {
-      const QCPGraphData &current = data.at(i);
-      if (!qIsNaN(current.value)) {
-        const double key = keyAxis->coordToPixel(current.key);
-        result[i * 2 + 0].setX(valueAxis->coordToPixel(0));
-        result[i * 2 + 0].setY(key);
-        result[i * 2 + 1].setX(valueAxis->coordToPixel(current.value));
-        result[i * 2 + 1].setY(key);
-      } else {
-        result[i * 2 + 0] = QPointF(0, 0);
-        result[i * 2 + 1] = QPointF(0, 0);
-      }
-    }
-  } else {
-    for (int i = 0; i < data.size(); ++i) {
-      const QCPGraphData &current = data.at(i);
-      if (!qIsNaN(current.value)) {
-        const double key = keyAxis->coordToPixel(data.at(i).key);
-        result[i * 2 + 0].setX(key);
-        result[i * 2 + 0].setY(valueAxis->coordToPixel(0));
-        result[i * 2 + 1].setX(key);
-        result[i * 2 + 1].setY(valueAxis->coordToPixel(data.at(i).value));
-      } else {
-        result[i * 2 + 0] = QPointF(0, 0);
-        result[i * 2 + 1] = QPointF(0, 0);
-      }
+  const double zero = valueAxis->coordToPixel(0);
+  const QPointF base = vertical ? QPointF(zero, 0) : QPointF(0, zero);
+  for (int i = 0; i < data.size(); ++i) {
+    if (!qIsNaN(data.at(i).value)) {
+      result[i * 2 + 0] = qcpStepPixel(vertical, points.at(i), base);
+      result[i * 2 + 1] = points.at(i);
+    } else {
+      result[i * 2 + 0] = QPointF(0, 0);
+      result[i * 2 + 1] = QPointF(0, 0);
     }
   }
   return result;
@@ -11118,99 +11559,28 @@ void QCPGraph::getOptimizedLineData(
       maxCount = int(2 * keyPixelSpan + 2);
   }
 
-  if (mAdaptiveSampling && dataCount >= maxCount)
-
-  {
-    QCPGraphDataContainer::const_iterator it = begin;
-    double minValue = it->value;
-    double maxValue = it->value;
-    QCPGraphDataContainer::const_iterator currentIntervalFirstPoint = it;
-    int reversedFactor = keyAxis->pixelOrientation();
-
-    int reversedRound = reversedFactor == -1 ? 1 : 0;
-
-    double currentIntervalStartKey = keyAxis->pixelToCoord(
-        int(keyAxis->coordToPixel(begin->key) + reversedRound));
-    double lastIntervalEndKey = currentIntervalStartKey;
-    double keyEpsilon = qAbs(
-        currentIntervalStartKey -
-        keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey) +
-                              1.0 * reversedFactor));
-
-    bool keyEpsilonVariable = keyAxis->scaleType() == QCPAxis::stLogarithmic;
-
-    int intervalDataCount = 1;
-    ++it;
-
-    while (it != end) {
-      if (it->key < currentIntervalStartKey + keyEpsilon)
-
-      {
-        if (it->value < minValue)
-          minValue = it->value;
-        else if (it->value > maxValue)
-          maxValue = it->value;
-        ++intervalDataCount;
-      } else {
-        if (intervalDataCount >= 2)
-
-        {
-          if (lastIntervalEndKey < currentIntervalStartKey - keyEpsilon)
-
-            lineData->append(
-                QCPGraphData(currentIntervalStartKey + keyEpsilon * 0.2,
-                             currentIntervalFirstPoint->value));
-          lineData->append(QCPGraphData(
-              currentIntervalStartKey + keyEpsilon * 0.25, minValue));
-          lineData->append(QCPGraphData(
-              currentIntervalStartKey + keyEpsilon * 0.75, maxValue));
-          if (it->key > currentIntervalStartKey + keyEpsilon * 2)
-
-            lineData->append(QCPGraphData(
-                currentIntervalStartKey + keyEpsilon * 0.8, (it - 1)->value));
-        } else
-          lineData->append(QCPGraphData(currentIntervalFirstPoint->key,
-                                        currentIntervalFirstPoint->value));
-        lastIntervalEndKey = (it - 1)->key;
-        minValue = it->value;
-        maxValue = it->value;
-        currentIntervalFirstPoint = it;
-        currentIntervalStartKey = keyAxis->pixelToCoord(
-            int(keyAxis->coordToPixel(it->key) + reversedRound));
-        if (keyEpsilonVariable)
-          keyEpsilon = qAbs(currentIntervalStartKey -
-                            keyAxis->pixelToCoord(
-                                keyAxis->coordToPixel(currentIntervalStartKey) +
-                                1.0 * reversedFactor));
-        intervalDataCount = 1;
-      }
-      ++it;
-    }
-
-    if (intervalDataCount >= 2)
-
-    {
-      if (lastIntervalEndKey < currentIntervalStartKey - keyEpsilon)
-
-        lineData->append(
-            QCPGraphData(currentIntervalStartKey + keyEpsilon * 0.2,
-                         currentIntervalFirstPoint->value));
-      lineData->append(
-          QCPGraphData(currentIntervalStartKey + keyEpsilon * 0.25, minValue));
-      lineData->append(
-          QCPGraphData(currentIntervalStartKey + keyEpsilon * 0.75, maxValue));
-    } else
-      lineData->append(QCPGraphData(currentIntervalFirstPoint->key,
-                                    currentIntervalFirstPoint->value));
-
-  } else
-
-  {
+  if (mAdaptiveSampling && dataCount >= maxCount) {
+    const QCPGraphDataContainer::const_iterator front =
+        mDataContainer->constBegin();
+    QCPGraphLineSource source = {&*front, &mDataContainer->levels()};
+    updateLevels();
+    qcpGetLineData(source, keyAxis, int(begin - front), int(end - front),
+                   mAdaptiveSamplingThreads, lineData);
+  } else {
     lineData->resize(dataCount);
     std::copy(begin, end, lineData->begin());
   }
 }
 
+// Brings the level-of-detail pyramid of the data up to date. Reading it is
+// safe from several threads once this has run on the GUI thread.
+void QCPGraph::updateLevels() const {
+  const QCPDataLevels &levels = mDataContainer->levels();
+  if (!levels.isEnabled() || mDataContainer->isEmpty()) return;
+  QCPGraphLineSource source = {&*mDataContainer->constBegin(), &levels};
+  levels.update(source, mDataContainer->size());
+}
+
 void QCPGraph::getOptimizedScatterData(
     QVector<QCPGraphData> *scatterData,
     QCPGraphDataContainer::const_iterator begin,
@@ -11786,6 +12156,618 @@ int QCPGraph::findIndexBelowY(const QVector<QPointF> *data, double y) const {
   return -1;
 }
 
+namespace {
+
+template <class T>
+QCPRange qcpUniformValueRange(const T *values, int begin, int end,
+                              QCP::SignDomain signDomain, bool &foundRange) {
+  double lower = std::numeric_limits<double>::infinity();
+  double upper = -lower;
+  for (int i = begin; i < end; ++i) {
+    const double value = values[i];
+    if (!std::isfinite(value) ||
+        (signDomain == QCP::sdNegative && value >= 0) ||
+        (signDomain == QCP::sdPositive && value <= 0))
+      continue;
+    lower = qMin(lower, value);
+    upper = qMax(upper, value);
+  }
+  foundRange = lower <= upper;
+  return foundRange ? QCPRange(lower, upper) : QCPRange();
+}
+
+// Uniform graph data for qcpGetLineData().
+template <class T>
+struct QCPUniformLineSource {
+  const QCPUniformGraphData *data;
+  const T *values;
+  double key(int index) const { return data->key(index); }
+  T value(int index) const { return values[index]; }
+  int findBegin(double key, int begin, int end) const {
+    return qBound(begin, data->findBegin(key, false), end);
+  }
+  bool findExtremes(int, int, int *, int *) const { return false; }
+};
+
+}  // namespace
+
+/*! \class QCPUniformGraphData
+  \brief Holds the data of a QCPUniformGraph: values at evenly spaced keys.
+
+  The key of point \a index is keyOrigin() + \a index * keyStep(), so only the
+  values are stored: as doubles, or as floats with \ref setSinglePrecision.
+  That is 8 or 4 bytes per point instead of the 16 of \ref QCPGraphData, and
+  \ref findBegin and \ref findEnd compute the index from the key instead of
+  searching for it.
+
+  Values may be NaN, which breaks the line of the graph there. Unlike
+  QCPGraphDataContainer, indices passed to \ref value, \ref setValue and
+  \ref setValues are not checked.
+*/
+
+/*! \fn double QCPUniformGraphData::key(int index) const
+
+  Returns the key of the point \a index, keyOrigin() + \a index * keyStep().
+*/
+
+/*! \fn double QCPUniformGraphData::value(int index) const
+
+  Returns the value of the point \a index, which must be less than \ref size.
+*/
+
+/*!
+  Constructs empty data with key origin 0, key step 1 and double values.
+*/
+QCPUniformGraphData::QCPUniformGraphData()
+    : mKeyOrigin(0), mKeyStep(1), mSinglePrecision(false) {}
+
+/*!
+  Returns the number of points.
+*/
+int QCPUniformGraphData::size() const {
+  return int(mSinglePrecision ? mSingleValues.size() : mValues.size());
+}
+
+/*!
+  Sets the key of the first point to \a keyOrigin and the distance between
+  neighbouring keys to \a keyStep. Both must be finite and \a keyStep positive,
+  otherwise the keys are left as they were.
+*/
+void QCPUniformGraphData::setKeys(double keyOrigin, double keyStep) {
+  if (!std::isfinite(keyOrigin) || !std::isfinite(keyStep) || keyStep <= 0) {
+    qDebug() << Q_FUNC_INFO << "invalid keys" << keyOrigin << keyStep;
+    return;
+  }
+  mKeyOrigin = keyOrigin;
+  mKeyStep = keyStep;
+}
+
+/*!
+  Sets whether the values are stored as floats instead of doubles, which halves
+  their memory. Values already stored are converted.
+*/
+void QCPUniformGraphData::setSinglePrecision(bool enabled) {
+  if (enabled == mSinglePrecision) return;
+  if (enabled) {
+    mSingleValues.resize(mValues.size());
+    std::copy(mValues.constBegin(), mValues.constEnd(), mSingleValues.begin());
+    mValues = QVector<double>();
+  } else {
+    mValues.resize(mSingleValues.size());
+    std::copy(mSingleValues.constBegin(), mSingleValues.constEnd(),
+              mValues.begin());
+    mSingleValues = QVector<float>();
+  }
+  mSinglePrecision = enabled;
+}
+
+/*!
+  Replaces the data with \a values at the keys given by \a keyOrigin and
+  \a keyStep, see \ref setKeys.
+*/
+void QCPUniformGraphData::setData(double keyOrigin, double keyStep,
+                                  const QVector<double> &values) {
+  setKeys(keyOrigin, keyStep);
+  resize(int(values.size()));
+  setValues(0, values.constData(), int(values.size()));
+}
+
+/*!
+  Sets the value of the point \a index, which must be less than \ref size.
+*/
+void QCPUniformGraphData::setValue(int index, double value) {
+  if (mSinglePrecision)
+    mSingleValues[index] = float(value);
+  else
+    mValues[index] = value;
+}
+
+/*!
+  Copies \a count \a values to the points from \a index on, which must all be
+  less than \ref size. This is the fast way to fill data sized with \ref resize.
+*/
+void QCPUniformGraphData::setValues(int index, const double *values,
+                                    int count) {
+  if (mSinglePrecision)
+    std::copy(values, values + count, mSingleValues.begin() + index);
+  else
+    std::copy(values, values + count, mValues.begin() + index);
+}
+
+/*!
+  Appends a point with \a value at the key after the last one.
+*/
+void QCPUniformGraphData::add(double value) {
+  if (mSinglePrecision)
+    mSingleValues.append(float(value));
+  else
+    mValues.append(value);
+}
+
+/*!
+  Sets the number of points to \a size. Points added at the end have the value
+  0.
+*/
+void QCPUniformGraphData::resize(int size) {
+  if (mSinglePrecision)
+    mSingleValues.resize(size);
+  else
+    mValues.resize(size);
+}
+
+/*!
+  Removes all points and keeps the keys.
+*/
+void QCPUniformGraphData::clear() {
+  mValues.clear();
+  mSingleValues.clear();
+}
+
+/*!
+  Frees the memory reserved beyond the current points.
+*/
+void QCPUniformGraphData::squeeze() {
+  mValues.squeeze();
+  mSingleValues.squeeze();
+}
+
+/*!
+  Returns the index of the first point whose key is not below \a key, or
+  \ref size if there is none. If \a expandedRange is true, the point before
+  it is included, so that lines reach the left border of an axis range.
+
+  The index is computed from the key in constant time.
+
+  \see findEnd
+*/
+int QCPUniformGraphData::findBegin(double key, bool expandedRange) const {
+  const int n = size();
+  int i = 0;
+  if (key > mKeyOrigin) {
+    const double estimate = std::ceil((key - mKeyOrigin) / mKeyStep);
+    i = estimate < n ? int(estimate) : n;
+    while (i > 0 && !(this->key(i - 1) < key)) --i;
+    while (i < n && this->key(i) < key) ++i;
+  }
+  if (expandedRange && i > 0) --i;
+  return i;
+}
+
+/*!
+  Returns the index past the last point whose key is not above \a key. If
+  \a expandedRange is true, the point after it is included, so that lines
+  reach the right border of an axis range.
+
+  The index is computed from the key in constant time.
+
+  \see findBegin
+*/
+int QCPUniformGraphData::findEnd(double key, bool expandedRange) const {
+  const int n = size();
+  int i = n;
+  if (!qIsNaN(key)) {
+    const double estimate = std::floor((key - mKeyOrigin) / mKeyStep) + 1;
+    i = estimate < 0 ? 0 : estimate < n ? int(estimate) : n;
+    while (i > 0 && this->key(i - 1) > key) --i;
+    while (i < n && !(this->key(i) > key)) ++i;
+  }
+  if (expandedRange && i < n) ++i;
+  return i;
+}
+
+/*!
+  Returns the range of the keys of the points with values that are not NaN,
+  limited to \a signDomain. \a foundRange is set to whether there are any.
+*/
+QCPRange QCPUniformGraphData::keyRange(bool &foundRange,
+                                       QCP::SignDomain signDomain) const {
+  const int n = size();
+  int first = 0;
+  int last = n - 1;
+  while (first < n && (qIsNaN(value(first)) ||
+                       (signDomain == QCP::sdNegative && key(first) >= 0) ||
+                       (signDomain == QCP::sdPositive && key(first) <= 0)))
+    ++first;
+  while (last >= first && (qIsNaN(value(last)) ||
+                           (signDomain == QCP::sdNegative && key(last) >= 0) ||
+                           (signDomain == QCP::sdPositive && key(last) <= 0)))
+    --last;
+  foundRange = first <= last;
+  return foundRange ? QCPRange(key(first), key(last)) : QCPRange();
+}
+
+/*!
+  Returns the range of the finite values in \a signDomain, of the points with
+  keys in \a inKeyRange, or of all points if it is the default QCPRange().
+  \a foundRange is set to whether there are any.
+*/
+QCPRange QCPUniformGraphData::valueRange(bool &foundRange,
+                                         QCP::SignDomain signDomain,
+                                         const QCPRange &inKeyRange) const {
+  int begin = 0;
+  int end = size();
+  if (inKeyRange != QCPRange()) {
+    begin = findBegin(inKeyRange.lower, false);
+    end = findEnd(inKeyRange.upper, false);
+  }
+  if (mSinglePrecision)
+    return qcpUniformValueRange(mSingleValues.constData(), begin, end,
+                                signDomain, foundRange);
+  return qcpUniformValueRange(mValues.constData(), begin, end, signDomain,
+                              foundRange);
+}
+
+/*! \class QCPUniformGraph
+  \brief A plottable representing a graph with evenly spaced keys.
+
+  It draws a \ref QCPUniformGraphData as a line, like a QCPGraph with line
+  style QCPGraph::lsLine and no scatters or fill. Function plots and sampled
+  signals have evenly spaced keys, and for them this takes half or a quarter
+  of the memory of QCPGraph and finds the visible points without a search.
+
+  Fill the data in place through \ref data, or share one with
+  \ref setData(QSharedPointer<QCPUniformGraphData>):
+  \code
+  QCPUniformGraph *graph = new QCPUniformGraph(customPlot->xAxis,
+                                               customPlot->yAxis);
+  graph->data()->setKeys(xmin, step);
+  graph->data()->resize(count);
+  graph->data()->setValues(0, values, count);
+  \endcode
+
+  With adaptive sampling, which is on by default, each pixel column of a dense
+  graph is drawn from its first, lowest, highest and last point, which keeps
+  its look. See \ref setAdaptiveSampling and
+  \ref setAdaptiveSamplingThreads.
+*/
+
+/*! \fn QSharedPointer<QCPUniformGraphData> QCPUniformGraph::data() const
+
+  Returns a shared pointer to the data of this graph, which may be changed in
+  place. Call \ref QCustomPlot::replot to show the changes.
+*/
+
+/*!
+  Constructs a graph which uses \a keyAxis as its key axis and \a valueAxis as
+  its value axis. Both must reside in the same QCustomPlot, which takes
+  ownership of the graph.
+*/
+QCPUniformGraph::QCPUniformGraph(QCPAxis *keyAxis, QCPAxis *valueAxis)
+    : QCPAbstractPlottable(keyAxis, valueAxis),
+      mData(new QCPUniformGraphData),
+      mAdaptiveSampling{},
+      mAdaptiveSamplingThreads{} {
+  setPen(QPen(Qt::blue, 0));
+  setBrush(Qt::NoBrush);
+  setAdaptiveSampling(true);
+  setAdaptiveSamplingThreads(1);
+}
+
+QCPUniformGraph::~QCPUniformGraph() {}
+
+/*! \overload
+
+  Makes the graph use \a data, which may be shared with other graphs.
+*/
+void QCPUniformGraph::setData(QSharedPointer<QCPUniformGraphData> data) {
+  mData = data;
+}
+
+/*!
+  Replaces the data of this graph with \a values at the keys given by
+  \a keyOrigin and \a keyStep. See \ref QCPUniformGraphData::setData.
+*/
+void QCPUniformGraph::setData(double keyOrigin, double keyStep,
+                              const QVector<double> &values) {
+  mData->setData(keyOrigin, keyStep, values);
+}
+
+/*!
+  Sets whether dense parts of the graph are reduced to four points per pixel
+  column before drawing: the first, lowest, highest and last one of each run
+  of non-NaN values. The drawn line looks the same, and drawing costs
+  depend on the width of the plot instead of the number of points.
+*/
+void QCPUniformGraph::setAdaptiveSampling(bool enabled) {
+  mAdaptiveSampling = enabled;
+}
+
+/*!
+  Sets how many threads share the adaptive sampling of large graphs; smaller
+  ones are sampled on the calling thread only. The default is 1.
+
+  \see setAdaptiveSampling
+*/
+void QCPUniformGraph::setAdaptiveSamplingThreads(int threads) {
+  mAdaptiveSamplingThreads = qMax(1, threads);
+}
+
+/* inherits documentation from base class */
+int QCPUniformGraph::dataCount() const { return mData->size(); }
+
+/* inherits documentation from base class */
+double QCPUniformGraph::dataMainKey(int index) const {
+  if (index >= 0 && index < mData->size()) return mData->key(index);
+  qDebug() << Q_FUNC_INFO << "Index out of bounds" << index;
+  return 0;
+}
+
+/* inherits documentation from base class */
+double QCPUniformGraph::dataSortKey(int index) const {
+  return dataMainKey(index);
+}
+
+/* inherits documentation from base class */
+double QCPUniformGraph::dataMainValue(int index) const {
+  if (index >= 0 && index < mData->size()) return mData->value(index);
+  qDebug() << Q_FUNC_INFO << "Index out of bounds" << index;
+  return 0;
+}
+
+/* inherits documentation from base class */
+QCPRange QCPUniformGraph::dataValueRange(int index) const {
+  const double value = dataMainValue(index);
+  return QCPRange(value, value);
+}
+
+/* inherits documentation from base class */
+QPointF QCPUniformGraph::dataPixelPosition(int index) const {
+  if (index >= 0 && index < mData->size())
+    return coordsToPixels(mData->key(index), mData->value(index));
+  qDebug() << Q_FUNC_INFO << "Index out of bounds" << index;
+  return QPointF();
+}
+
+/* inherits documentation from base class */
+QCPDataSelection QCPUniformGraph::selectTestRect(const QRectF &rect,
+                                                 bool onlySelectable) const {
+  QCPDataSelection result;
+  if ((onlySelectable && mSelectable == QCP::stNone) || mData->isEmpty())
+    return result;
+  if (!mKeyAxis || !mValueAxis) return result;
+
+  double key1, value1, key2, value2;
+  pixelsToCoords(rect.topLeft(), key1, value1);
+  pixelsToCoords(rect.bottomRight(), key2, value2);
+  QCPRange keyRange(key1, key2);
+  QCPRange valueRange(value1, value2);
+  const int begin = mData->findBegin(keyRange.lower, false);
+  const int end = mData->findEnd(keyRange.upper, false);
+
+  int currentSegmentBegin = -1;
+  for (int i = begin; i < end; ++i) {
+    const bool inside = valueRange.contains(mData->value(i));
+    if (currentSegmentBegin == -1 && inside) {
+      currentSegmentBegin = i;
+    } else if (currentSegmentBegin != -1 && !inside) {
+      result.addDataRange(QCPDataRange(currentSegmentBegin, i), false);
+      currentSegmentBegin = -1;
+    }
+  }
+  if (currentSegmentBegin != -1)
+    result.addDataRange(QCPDataRange(currentSegmentBegin, end), false);
+
+  result.simplify();
+  return result;
+}
+
+/* inherits documentation from base class */
+int QCPUniformGraph::findBegin(double sortKey, bool expandedRange) const {
+  return mData->findBegin(sortKey, expandedRange);
+}
+
+/* inherits documentation from base class */
+int QCPUniformGraph::findEnd(double sortKey, bool expandedRange) const {
+  return mData->findEnd(sortKey, expandedRange);
+}
+
+/* inherits documentation from base class */
+double QCPUniformGraph::selectTest(const QPointF &pos, bool onlySelectable,
+                                   QVariant *details) const {
+  if ((onlySelectable && mSelectable == QCP::stNone) || mData->isEmpty())
+    return -1;
+  if (!mKeyAxis || !mValueAxis) return -1;
+  if (!mKeyAxis.data()->axisRect()->rect().contains(pos.toPoint()) &&
+      !mParentPlot->interactions().testFlag(
+          QCP::iSelectPlottablesBeyondAxisRect))
+    return -1;
+
+  double posKeyMin, posKeyMax, dummy;
+  pixelsToCoords(pos - QPointF(mParentPlot->selectionTolerance(),
+                               mParentPlot->selectionTolerance()),
+                 posKeyMin, dummy);
+  pixelsToCoords(pos + QPointF(mParentPlot->selectionTolerance(),
+                               mParentPlot->selectionTolerance()),
+                 posKeyMax, dummy);
+  if (posKeyMin > posKeyMax) qSwap(posKeyMin, posKeyMax);
+  const int begin = mData->findBegin(posKeyMin, true);
+  const int end = mData->findEnd(posKeyMax, true);
+
+  QCPVector2D p(pos);
+  double minDistSqr = (std::numeric_limits<double>::max)();
+  int closest = -1;
+  QPointF previous;
+  bool havePrevious = false;
+  for (int i = begin; i < end; ++i) {
+    const double value = mData->value(i);
+    if (qIsNaN(value)) {
+      havePrevious = false;
+      continue;
+    }
+    const QPointF point = coordsToPixels(mData->key(i), value);
+    const double currentDistSqr = QCPVector2D(point - pos).lengthSquared();
+    if (currentDistSqr < minDistSqr) {
+      minDistSqr = currentDistSqr;
+      closest = i;
+    }
+    if (havePrevious)
+      minDistSqr = qMin(minDistSqr, p.distanceSquaredToLine(previous, point));
+    previous = point;
+    havePrevious = true;
+  }
+  if (closest == -1) return -1;
+  if (details)
+    details->setValue(QCPDataSelection(QCPDataRange(closest, closest + 1)));
+  return qSqrt(minDistSqr);
+}
+
+/* inherits documentation from base class */
+QCPRange QCPUniformGraph::getKeyRange(bool &foundRange,
+                                      QCP::SignDomain inSignDomain) const {
+  return mData->keyRange(foundRange, inSignDomain);
+}
+
+/* inherits documentation from base class */
+QCPRange QCPUniformGraph::getValueRange(bool &foundRange,
+                                        QCP::SignDomain inSignDomain,
+                                        const QCPRange &inKeyRange) const {
+  return mData->valueRange(foundRange, inSignDomain, inKeyRange);
+}
+
+void QCPUniformGraph::draw(QCPPainter *painter) {
+  if (!mKeyAxis || !mValueAxis) {
+    qDebug() << Q_FUNC_INFO << "invalid key or value axis";
+    return;
+  }
+  if (mKeyAxis.data()->range().size() <= 0 || mData->isEmpty()) return;
+
+  QVector<QPointF> lines;
+  QList<QCPDataRange> selectedSegments, unselectedSegments, allSegments;
+  getDataSegments(selectedSegments, unselectedSegments);
+  allSegments << unselectedSegments << selectedSegments;
+  for (int i = 0; i < allSegments.size(); ++i) {
+    bool isSelectedSegment = i >= unselectedSegments.size();
+    QCPDataRange lineDataRange = isSelectedSegment
+                                     ? allSegments.at(i)
+                                     : allSegments.at(i).adjusted(-1, 1);
+    getLines(&lines, lineDataRange);
+
+    if (isSelectedSegment && mSelectionDecorator)
+      mSelectionDecorator->applyPen(painter);
+    else
+      painter->setPen(mPen);
+    painter->setBrush(Qt::NoBrush);
+    drawLinePlot(painter, lines);
+  }
+
+  if (mSelectionDecorator)
+    mSelectionDecorator->drawDecoration(painter, selection());
+}
+
+void QCPUniformGraph::drawLegendIcon(QCPPainter *painter,
+                                     const QRectF &rect) const {
+  applyDefaultAntialiasingHint(painter);
+  painter->setPen(mPen);
+  painter->drawLine(QLineF(rect.left(), rect.top() + rect.height() / 2.0,
+                           rect.right() + 5, rect.top() + rect.height() / 2.0));
+}
+
+void QCPUniformGraph::drawLinePlot(QCPPainter *painter,
+                                   const QVector<QPointF> &lines) const {
+  if (painter->pen().style() == Qt::NoPen ||
+      painter->pen().color().alpha() == 0)
+    return;
+  applyDefaultAntialiasingHint(painter);
+  if (!painter->modes().testFlag(QCPPainter::pmVectorized) &&
+      qFuzzyCompare(painter->pen().widthF(), 1.0)) {
+    QPen newPen = painter->pen();
+    newPen.setWidth(0);
+    painter->setPen(newPen);
+  }
+
+  int segmentStart = 0;
+  for (int i = 0; i < lines.size(); ++i) {
+    if (qIsNaN(lines.at(i).y()) || qIsNaN(lines.at(i).x()) ||
+        qIsInf(lines.at(i).y())) {
+      painter->drawPolyline(lines.constData() + segmentStart,
+                            i - segmentStart);
+      segmentStart = i + 1;
+    }
+  }
+  painter->drawPolyline(lines.constData() + segmentStart,
+                        int(lines.size()) - segmentStart);
+}
+
+void QCPUniformGraph::getDataSegments(
+    QList<QCPDataRange> &selectedSegments,
+    QList<QCPDataRange> &unselectedSegments) const {
+  selectedSegments.clear();
+  unselectedSegments.clear();
+  if (mSelectable == QCP::stWhole) {
+    if (selected())
+      selectedSegments << QCPDataRange(0, dataCount());
+    else
+      unselectedSegments << QCPDataRange(0, dataCount());
+  } else {
+    QCPDataSelection sel(selection());
+    sel.simplify();
+    selectedSegments = sel.dataRanges();
+    unselectedSegments = sel.inverse(QCPDataRange(0, dataCount())).dataRanges();
+  }
+}
+
+void QCPUniformGraph::getLines(QVector<QPointF> *lines,
+                               const QCPDataRange &dataRange) const {
+  if (!lines) return;
+  lines->clear();
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QCPAxis *valueAxis = mValueAxis.data();
+  if (!keyAxis || !valueAxis) {
+    qDebug() << Q_FUNC_INFO << "invalid key or value axis";
+    return;
+  }
+  const int begin =
+      qMax(mData->findBegin(keyAxis->range().lower), dataRange.begin());
+  const int end = qMin(mData->findEnd(keyAxis->range().upper), dataRange.end());
+  if (begin >= end) return;
+
+  const double keyPixelSpan =
+      qAbs(keyAxis->coordToPixel(mData->key(begin)) -
+           keyAxis->coordToPixel(mData->key(end - 1)));
+  QVector<QCPGraphData> lineData;
+  if (mAdaptiveSampling && end - begin >= 2 * keyPixelSpan + 2) {
+    if (mData->singlePrecision()) {
+      QCPUniformLineSource<float> source = {mData.data(),
+                                            mData->mSingleValues.constData()};
+      qcpGetLineData(source, keyAxis, begin, end, mAdaptiveSamplingThreads,
+                     &lineData);
+    } else {
+      QCPUniformLineSource<double> source = {mData.data(),
+                                             mData->mValues.constData()};
+      qcpGetLineData(source, keyAxis, begin, end, mAdaptiveSamplingThreads,
+                     &lineData);
+    }
+  } else {
+    lineData.resize(end - begin);
+    for (int i = begin; i < end; ++i)
+      lineData[i - begin] = QCPGraphData(mData->key(i), mData->value(i));
+  }
+
+  lines->resize(lineData.size());
+  qcpDataToPixels(keyAxis, valueAxis, lineData.constData(), lines->data(),
+                  int(lineData.size()));
+}
+
 QCPCurveData::QCPCurveData() : t(0), key(0), value(0) {}
 
 QCPCurveData::QCPCurveData(double t, double key, double value)
@@ -12065,6 +13047,9 @@ void QCPCurve::getCurveLines(QVector<QPointF> *lines,
   QCPCurveDataContainer::const_iterator itEnd = mDataContainer->constEnd();
   mDataContainer->limitIteratorsToDataRange(itBegin, itEnd, dataRange);
   if (itBegin == itEnd) return;
+  QVector<QPointF> pixels(int(itEnd - itBegin));
+  qcpDataToPixels(keyAxis, valueAxis, &*itBegin, pixels.data(),
+                  int(pixels.size()));
   QCPCurveDataContainer::const_iterator it = itBegin;
   QCPCurveDataContainer::const_iterator prevIt = itEnd - 1;
   int prevRegion =
@@ -12125,11 +13110,11 @@ void QCPCurve::getCurveLines(QVector<QPointF> *lines,
           lines->append(getOptimizedPoint(prevRegion, prevIt->key,
                                           prevIt->value, it->key, it->value,
                                           keyMin, valueMax, keyMax, valueMin));
-        lines->append(coordsToPixels(it->key, it->value));
+        lines->append(pixels.at(int(it - itBegin)));
       }
     } else {
       if (currentRegion == 5) {
-        lines->append(coordsToPixels(it->key, it->value));
+        lines->append(pixels.at(int(it - itBegin)));
       } else {
       }
     }
@@ -12182,42 +13167,23 @@ void QCPCurve::getScatters(QVector<QPointF> *scatters,
     ++itIndex;
     ++it;
   }
-  if (keyAxis->orientation() == Qt::Vertical) {
-    while (it != end) {
-      if (!qIsNaN(it->value) && keyRange.contains(it->key) &&
-          valueRange.contains(it->value))
-        scatters->append(QPointF(valueAxis->coordToPixel(it->value),
-                                 keyAxis->coordToPixel(it->key)));
-
-      if (!doScatterSkip)
-        ++it;
-      else {
-        itIndex += scatterModulo;
-        if (itIndex < endIndex)
-          it += scatterModulo;
-        else {
-          it = end;
-          itIndex = endIndex;
-        }
-      }
-    }
-  } else {
-    while (it != end) {
-      if (!qIsNaN(it->value) && keyRange.contains(it->key) &&
-          valueRange.contains(it->value))
-        scatters->append(QPointF(keyAxis->coordToPixel(it->key),
-                                 valueAxis->coordToPixel(it->value)));
+  QVector<QPointF> pixels(int(end - begin));
+  qcpDataToPixels(keyAxis, valueAxis, &*begin, pixels.data(),
+                  int(pixels.size()));
+  while (it != end) {
+    if (!qIsNaN(it->value) && keyRange.contains(it->key) &&
+        valueRange.contains(it->value))
+      scatters->append(pixels.at(int(it - begin)));
 
-      if (!doScatterSkip)
-        ++it;
+    if (!doScatterSkip)
+      ++it;
+    else {
+      itIndex += scatterModulo;
+      if (itIndex < endIndex)
+        it += scatterModulo;
       else {
-        itIndex += scatterModulo;
-        if (itIndex < endIndex)
-          it += scatterModulo;
-        else {
-          it = end;
-          itIndex = endIndex;
-        }
+        it = end;
+        itIndex = endIndex;
       }
     }
   }
@@ -14073,7 +15039,9 @@ QCPColorMapData::QCPColorMapData(int keySize, int valueSize,
       mIsEmpty(true),
       mData(nullptr),
       mAlpha(nullptr),
-      mDataModified(true) {
+      mDataModified(true),
+      mModifiedBegin(0),
+      mModifiedEnd(0) {
   setSize(keySize, valueSize);
   fill(0);
 }
@@ -14089,7 +15057,9 @@ QCPColorMapData::QCPColorMapData(const QCPColorMapData &other)
       mIsEmpty(true),
       mData(nullptr),
       mAlpha(nullptr),
-      mDataModified(true) {
+      mDataModified(true),
+      mModifiedBegin(0),
+      mModifiedEnd(0) {
   *this = other;
 }
 
@@ -14109,7 +15079,7 @@ QCPColorMapData &QCPColorMapData::operator=(const QCPColorMapData &other) {
                sizeof(mAlpha[0]) * size_t(keySize * valueSize));
     }
     mDataBounds = other.mDataBounds;
-    mDataModified = true;
+    markModified(0, mValueSize);
   }
   return *this;
 }
@@ -14171,7 +15141,7 @@ void QCPColorMapData::setSize(int keySize, int valueSize) {
 
     if (mAlpha) createAlpha();
 
-    mDataModified = true;
+    markModified(0, mValueSize);
   }
 }
 
@@ -14208,7 +15178,7 @@ void QCPColorMapData::setData(double key, double value, double z) {
     mData[valueCell * mKeySize + keyCell] = z;
     if (z < mDataBounds.lower) mDataBounds.lower = z;
     if (z > mDataBounds.upper) mDataBounds.upper = z;
-    mDataModified = true;
+    markModified(valueCell, valueCell + 1);
   }
 }
 
@@ -14218,7 +15188,7 @@ void QCPColorMapData::setCell(int keyIndex, int valueIndex, double z) {
     mData[valueIndex * mKeySize + keyIndex] = z;
     if (z < mDataBounds.lower) mDataBounds.lower = z;
     if (z > mDataBounds.upper) mDataBounds.upper = z;
-    mDataModified = true;
+    markModified(valueIndex, valueIndex + 1);
   } else
     qDebug() << Q_FUNC_INFO << "index out of bounds:" << keyIndex << valueIndex;
 }
@@ -14229,7 +15199,7 @@ void QCPColorMapData::setAlpha(int keyIndex, int valueIndex,
       valueIndex < mValueSize) {
     if (mAlpha || createAlpha()) {
       mAlpha[valueIndex * mKeySize + keyIndex] = alpha;
-      mDataModified = true;
+      markModified(valueIndex, valueIndex + 1);
     }
   } else
     qDebug() << Q_FUNC_INFO << "index out of bounds:" << keyIndex << valueIndex;
@@ -14255,7 +15225,7 @@ void QCPColorMapData::clearAlpha() {
   if (mAlpha) {
     delete[] mAlpha;
     mAlpha = nullptr;
-    mDataModified = true;
+    markModified(0, mValueSize);
   }
 }
 
@@ -14263,14 +15233,14 @@ void QCPColorMapData::fill(double z) {
   const int dataCount = mValueSize * mKeySize;
   memset(mData, z, dataCount * sizeof(*mData));
   mDataBounds = QCPRange(z, z);
-  mDataModified = true;
+  markModified(0, mValueSize);
 }
 
 void QCPColorMapData::fillAlpha(unsigned char alpha) {
   if (mAlpha || createAlpha(false)) {
     const int dataCount = mValueSize * mKeySize;
     memset(mAlpha, alpha, dataCount * sizeof(*mAlpha));
-    mDataModified = true;
+    markModified(0, mValueSize);
   }
 }
 
@@ -14322,6 +15292,19 @@ bool QCPColorMapData::createAlpha(bool initializeOpaque) {
   }
 }
 
+// Records that the rows valueIndexBegin .. valueIndexEnd - 1 changed, so
+// that QCPColorMap::updateMapImage() colors only those.
+void QCPColorMapData::markModified(int valueIndexBegin, int valueIndexEnd) {
+  if (mModifiedBegin >= mModifiedEnd) {
+    mModifiedBegin = valueIndexBegin;
+    mModifiedEnd = valueIndexEnd;
+  } else {
+    mModifiedBegin = qMin(mModifiedBegin, valueIndexBegin);
+    mModifiedEnd = qMax(mModifiedEnd, valueIndexEnd);
+  }
+  mDataModified = true;
+}
+
 QCPColorMap::QCPColorMap(QCPAxis *keyAxis, QCPAxis *valueAxis)
     : QCPAbstractPlottable(keyAxis, valueAxis),
       mDataScaleType(QCPAxis::stLinear),
@@ -14329,6 +15312,7 @@ QCPColorMap::QCPColorMap(QCPAxis *keyAxis, QCPAxis *valueAxis)
       mGradient(QCPColorGradient::gpCold),
       mInterpolate(true),
       mTightBoundary(false),
+      mImageThreads(1),
       mMapImageInvalidated(true) {}
 
 QCPColorMap::~QCPColorMap() { delete mMapData; }
@@ -14387,6 +15371,10 @@ void QCPColorMap::setInterpolate(bool enabled) {
 
 void QCPColorMap::setTightBoundary(bool enabled) { mTightBoundary = enabled; }
 
+void QCPColorMap::setImageThreads(int threads) {
+  mImageThreads = qMax(1, threads);
+}
+
 void QCPColorMap::setColorScale(QCPColorScale *colorScale) {
   if (mColorScale) {
     disconnect(this, SIGNAL(dataRangeChanged(QCPRange)), mColorScale.data(),
@@ -14530,18 +15518,23 @@ void QCPColorMap::updateMapImage() {
   int valueOversamplingFactor =
       mInterpolate ? 1 : int(1.0 + 100.0 / double(valueSize));
 
+  // A new image is colored whole, an existing one only where data changed.
+  bool recolor = mMapImageInvalidated;
   if (keyAxis->orientation() == Qt::Horizontal &&
       (mMapImage.width() != keySize * keyOversamplingFactor ||
-       mMapImage.height() != valueSize * valueOversamplingFactor))
+       mMapImage.height() != valueSize * valueOversamplingFactor)) {
     mMapImage = QImage(QSize(keySize * keyOversamplingFactor,
                              valueSize * valueOversamplingFactor),
                        format);
-  else if (keyAxis->orientation() == Qt::Vertical &&
-           (mMapImage.width() != valueSize * valueOversamplingFactor ||
-            mMapImage.height() != keySize * keyOversamplingFactor))
+    recolor = true;
+  } else if (keyAxis->orientation() == Qt::Vertical &&
+             (mMapImage.width() != valueSize * valueOversamplingFactor ||
+              mMapImage.height() != keySize * keyOversamplingFactor)) {
     mMapImage = QImage(QSize(valueSize * valueOversamplingFactor,
                              keySize * keyOversamplingFactor),
                        format);
+    recolor = true;
+  }
 
   if (mMapImage.isNull()) {
     qDebug() << Q_FUNC_INFO
@@ -14554,51 +15547,73 @@ void QCPColorMap::updateMapImage() {
     if (keyOversamplingFactor > 1 || valueOversamplingFactor > 1) {
       if (keyAxis->orientation() == Qt::Horizontal &&
           (mUndersampledMapImage.width() != keySize ||
-           mUndersampledMapImage.height() != valueSize))
+           mUndersampledMapImage.height() != valueSize)) {
         mUndersampledMapImage = QImage(QSize(keySize, valueSize), format);
-      else if (keyAxis->orientation() == Qt::Vertical &&
-               (mUndersampledMapImage.width() != valueSize ||
-                mUndersampledMapImage.height() != keySize))
+        recolor = true;
+      } else if (keyAxis->orientation() == Qt::Vertical &&
+                 (mUndersampledMapImage.width() != valueSize ||
+                  mUndersampledMapImage.height() != keySize)) {
         mUndersampledMapImage = QImage(QSize(valueSize, keySize), format);
+        recolor = true;
+      }
       localMapImage = &mUndersampledMapImage;
 
     } else if (!mUndersampledMapImage.isNull())
       mUndersampledMapImage = QImage();
 
+    // Rows of data are image lines with a horizontal key axis and image
+    // columns with a vertical one.
+    const bool horizontal = keyAxis->orientation() == Qt::Horizontal;
+    const bool logarithmic = mDataScaleType == QCPAxis::stLogarithmic;
+    const int rowBegin =
+        recolor ? 0 : qBound(0, mMapData->mModifiedBegin, valueSize);
+    const int rowEnd =
+        recolor ? valueSize
+                : qBound(rowBegin, mMapData->mModifiedEnd, valueSize);
+    const int lineCount = horizontal ? valueSize : keySize;
+    const int lineBegin = horizontal ? rowBegin : 0;
+    const int lineEnd = horizontal ? rowEnd : keySize;
+    const int first = horizontal ? 0 : rowBegin;
+    const int count = horizontal ? keySize : rowEnd - rowBegin;
+    const int stride = horizontal ? 1 : keySize;
     const double *rawData = mMapData->mData;
     const unsigned char *rawAlpha = mMapData->mAlpha;
-    if (keyAxis->orientation() == Qt::Horizontal) {
-      const int lineCount = valueSize;
-      const int rowCount = keySize;
-      for (int line = 0; line < lineCount; ++line) {
+    uchar *bits = localMapImage->bits();
+    const int bytesPerLine = localMapImage->bytesPerLine();
+    auto colorLines = [&](int begin, int end) {
+      for (int line = begin; line < end; ++line) {
         QRgb *pixels = reinterpret_cast<QRgb *>(
-            localMapImage->scanLine(lineCount - 1 - line));
-
-        if (rawAlpha)
-          mGradient.colorize(
-              rawData + line * rowCount, rawAlpha + line * rowCount, mDataRange,
-              pixels, rowCount, 1, mDataScaleType == QCPAxis::stLogarithmic);
-        else
-          mGradient.colorize(rawData + line * rowCount, mDataRange, pixels,
-                             rowCount, 1,
-                             mDataScaleType == QCPAxis::stLogarithmic);
-      }
-    } else {
-      const int lineCount = keySize;
-      const int rowCount = valueSize;
-      for (int line = 0; line < lineCount; ++line) {
-        QRgb *pixels = reinterpret_cast<QRgb *>(
-            localMapImage->scanLine(lineCount - 1 - line));
-
+                           bits + qint64(lineCount - 1 - line) * bytesPerLine) +
+                       first;
+        const qint64 offset = horizontal ? qint64(line) * keySize
+                                         : line + qint64(rowBegin) * keySize;
         if (rawAlpha)
-          mGradient.colorize(rawData + line, rawAlpha + line, mDataRange,
-                             pixels, rowCount, lineCount,
-                             mDataScaleType == QCPAxis::stLogarithmic);
+          mGradient.colorize(rawData + offset, rawAlpha + offset, mDataRange,
+                             pixels, count, stride, logarithmic);
         else
-          mGradient.colorize(rawData + line, mDataRange, pixels, rowCount,
-                             lineCount,
-                             mDataScaleType == QCPAxis::stLogarithmic);
+          mGradient.colorize(rawData + offset, mDataRange, pixels, count,
+                             stride, logarithmic);
       }
+    };
+
+    // The first line brings the gradient's color buffer up to date before
+    // the bands of the others are shared out over up to mImageThreads
+    // threads of at least kMinThreadCells cells.
+    if (lineBegin < lineEnd && count > 0) {
+      colorLines(lineBegin, lineBegin + 1);
+      const int rest = lineBegin + 1;
+      const int lines = lineEnd - rest;
+      const int threads = qMax(
+          1, qMin(mImageThreads,
+                  int(qint64(lines) * count / kMinThreadCells)));
+      std::vector<std::thread> workers;
+      for (int t = 1; t < threads; ++t)
+        workers.emplace_back([&, t]() {
+          colorLines(rest + int(qint64(lines) * t / threads),
+                     rest + int(qint64(lines) * (t + 1) / threads));
+        });
+      colorLines(rest, rest + lines / threads);
+      for (std::thread &worker : workers) worker.join();
     }
 
     if (keyOversamplingFactor > 1 || valueOversamplingFactor > 1) {
@@ -14615,6 +15630,7 @@ void QCPColorMap::updateMapImage() {
     }
   }
   mMapData->mDataModified = false;
+  mMapData->mModifiedBegin = mMapData->mModifiedEnd = 0;
   mMapImageInvalidated = false;
 }
 
@@ -527,6 +527,21 @@ class QCP_LIB_DECL QCPPaintBufferPixmap : public QCPAbstractPaintBuffer {
   virtual void reallocateBuffer() Q_DECL_OVERRIDE;
 };
 
+class QCP_LIB_DECL QCPPaintBufferImage : public QCPAbstractPaintBuffer {
+ public:
+  explicit QCPPaintBufferImage(const QSize &size, double devicePixelRatio);
+  virtual ~QCPPaintBufferImage() Q_DECL_OVERRIDE;
+
+  virtual QCPPainter *startPainting() Q_DECL_OVERRIDE;
+  virtual void draw(QCPPainter *painter) const Q_DECL_OVERRIDE;
+  void clear(const QColor &color) Q_DECL_OVERRIDE;
+
+ protected:
+  QImage mBuffer;
+
+  virtual void reallocateBuffer() Q_DECL_OVERRIDE;
+};
+
 #ifdef QCP_OPENGL_PBUFFER
 class QCP_LIB_DECL QCPPaintBufferGlPbuffer : public QCPAbstractPaintBuffer {
  public:
@@ -614,7 +629,7 @@ class QCP_LIB_DECL QCPLayer : public QObject {
   QWeakPointer<QCPAbstractPaintBuffer> mPaintBuffer;
 
   void draw(QCPPainter *painter);
-  void drawToPaintBuffer();
+  void drawToPaintBuffer(bool guiThread = true);
   void addChild(QCPLayerable *layerable, bool prepend);
   void removeChild(QCPLayerable *layerable);
 
@@ -1995,6 +2010,8 @@ class QCP_LIB_DECL QCPAxis : public QCPLayerable {
   void rescale(bool onlyVisiblePlottables = false);
   double pixelToCoord(double value) const;
   double coordToPixel(double value) const;
+  void coordToPixel(const double *coords, double *pixels, int count,
+                    int coordStride = 1, int pixelStride = 1) const;
   SelectablePart getPartAt(const QPointF &pos) const;
   QList<QCPAbstractPlottable *> plottables() const;
   QList<QCPGraph *> graphs() const;
@@ -2278,6 +2295,59 @@ inline bool qcpLessThanSortKey(const DataType &a, const DataType &b) {
   return a.sortKey() < b.sortKey();
 }
 
+// Min/max level-of-detail pyramid over the main values of a data container:
+// level l holds, for every 64 << l points, the index of the lowest and the
+// highest one. The container reports which points its changes leave right;
+// the levels are brought up to date when they are read, so appends cost only
+// the new points and removals at the front nothing. Changes made through
+// the container's begin() and end() need a call to the container's
+// invalidateLevels().
+class QCP_LIB_DECL QCPDataLevels {
+ public:
+  QCPDataLevels() : mEnabled(false), mValid(0), mRemoved(0) {}
+
+  bool isEnabled() const { return mEnabled; }
+  void setEnabled(bool enabled) {
+    mEnabled = enabled;
+    reset();
+  }
+  void reset() {
+    mValid = 0;
+    mRemoved = 0;
+    mLevels.clear();
+    mFirst.clear();
+  }
+  void invalidate(int index) {
+    if (index <= 0)
+      reset();
+    else
+      mValid = qMin(mValid, index);
+  }
+  void removeFront(int count) {
+    mRemoved += count;
+    mValid = qMax(0, mValid - count);
+  }
+
+  template <class Source>
+  void update(const Source &source, int size) const;
+  template <class Source>
+  bool findExtremes(const Source &source, int begin, int end, int *low,
+                    int *high) const;
+
+ protected:
+  // Points are numbered from the front at the last reset, so that removals
+  // there keep the blocks; low is -1 for blocks with NaN or infinite values.
+  struct Block {
+    qint64 low, high;
+  };
+
+  bool mEnabled;
+  mutable int mValid;
+  qint64 mRemoved;
+  mutable QVector<QVector<Block> > mLevels;
+  mutable QVector<qint64> mFirst;
+};
+
 template <class DataType>
 class QCPDataContainer
 
@@ -2291,8 +2361,11 @@ class QCPDataContainer
   int size() const { return mData.size() - mPreallocSize; }
   bool isEmpty() const { return size() == 0; }
   bool autoSqueeze() const { return mAutoSqueeze; }
+  bool levelOfDetail() const { return mLevels.isEnabled(); }
+  const QCPDataLevels &levels() const { return mLevels; }
 
   void setAutoSqueeze(bool enabled);
+  void setLevelOfDetail(bool enabled);
 
   void set(const QCPDataContainer<DataType> &data);
   void set(const QVector<DataType> &data, bool alreadySorted = false);
@@ -2304,8 +2377,10 @@ class QCPDataContainer
   void remove(double sortKeyFrom, double sortKeyTo);
   void remove(double sortKey);
   void clear();
+  void resize(int size);
   void sort();
   void squeeze(bool preAllocation = true, bool postAllocation = true);
+  void invalidateLevels() { mLevels.reset(); }
 
   const_iterator constBegin() const {
     return mData.constBegin() + mPreallocSize;
@@ -2328,6 +2403,7 @@ class QCPDataContainer
 
  protected:
   bool mAutoSqueeze;
+  QCPDataLevels mLevels;
 
   QVector<DataType> mData;
   int mPreallocSize;
@@ -2349,6 +2425,11 @@ void QCPDataContainer<DataType>::setAutoSqueeze(bool enabled) {
   }
 }
 
+template <class DataType>
+void QCPDataContainer<DataType>::setLevelOfDetail(bool enabled) {
+  if (mLevels.isEnabled() != enabled) mLevels.setEnabled(enabled);
+}
+
 template <class DataType>
 void QCPDataContainer<DataType>::set(const QCPDataContainer<DataType> &data) {
   clear();
@@ -2361,6 +2442,7 @@ void QCPDataContainer<DataType>::set(const QVector<DataType> &data,
   mData = data;
   mPreallocSize = 0;
   mPreallocIteration = 0;
+  mLevels.reset();
   if (!alreadySorted) sort();
 }
 
@@ -2378,14 +2460,21 @@ void QCPDataContainer<DataType>::add(const QCPDataContainer<DataType> &data) {
     if (mPreallocSize < n) preallocateGrow(n);
     mPreallocSize -= n;
     std::copy(data.constBegin(), data.constEnd(), begin());
+    mLevels.reset();
   } else {
     mData.resize(mData.size() + n);
     std::copy(data.constBegin(), data.constEnd(), end() - n);
     if (oldSize > 0 &&
         !qcpLessThanSortKey<DataType>(*(constEnd() - n - 1), *(constEnd() - n)))
 
+    {
+      mLevels.invalidate(int(
+          std::upper_bound(constBegin(), constEnd() - n, *(constEnd() - n),
+                           qcpLessThanSortKey<DataType>) -
+          constBegin()));
       std::inplace_merge(begin(), end() - n, end(),
                          qcpLessThanSortKey<DataType>);
+    }
   }
 }
 
@@ -2408,6 +2497,7 @@ void QCPDataContainer<DataType>::add(const QVector<DataType> &data,
     if (mPreallocSize < n) preallocateGrow(n);
     mPreallocSize -= n;
     std::copy(data.constBegin(), data.constEnd(), begin());
+    mLevels.reset();
   } else
 
   {
@@ -2418,8 +2508,14 @@ void QCPDataContainer<DataType>::add(const QVector<DataType> &data,
     if (oldSize > 0 &&
         !qcpLessThanSortKey<DataType>(*(constEnd() - n - 1), *(constEnd() - n)))
 
+    {
+      mLevels.invalidate(int(
+          std::upper_bound(constBegin(), constEnd() - n, *(constEnd() - n),
+                           qcpLessThanSortKey<DataType>) -
+          constBegin()));
       std::inplace_merge(begin(), end() - n, end(),
                          qcpLessThanSortKey<DataType>);
+    }
   }
 }
 
@@ -2435,9 +2531,11 @@ void QCPDataContainer<DataType>::add(const DataType &data) {
     if (mPreallocSize < 1) preallocateGrow(1);
     --mPreallocSize;
     *begin() = data;
+    mLevels.reset();
   } else {
     QCPDataContainer<DataType>::iterator insertionPoint =
         std::lower_bound(begin(), end(), data, qcpLessThanSortKey<DataType>);
+    mLevels.invalidate(int(insertionPoint - begin()));
     mData.insert(insertionPoint, data);
   }
 }
@@ -2449,6 +2547,7 @@ void QCPDataContainer<DataType>::removeBefore(double sortKey) {
       std::lower_bound(begin(), end(), DataType::fromSortKey(sortKey),
                        qcpLessThanSortKey<DataType>);
   mPreallocSize += int(itEnd - it);
+  mLevels.removeFront(int(itEnd - it));
 
   if (mAutoSqueeze) performAutoSqueeze();
 }
@@ -2459,6 +2558,7 @@ void QCPDataContainer<DataType>::removeAfter(double sortKey) {
       std::upper_bound(begin(), end(), DataType::fromSortKey(sortKey),
                        qcpLessThanSortKey<DataType>);
   QCPDataContainer<DataType>::iterator itEnd = end();
+  mLevels.invalidate(int(it - begin()));
   mData.erase(it, itEnd);
   if (mAutoSqueeze) performAutoSqueeze();
 }
@@ -2473,6 +2573,7 @@ void QCPDataContainer<DataType>::remove(double sortKeyFrom, double sortKeyTo) {
   QCPDataContainer<DataType>::iterator itEnd =
       std::upper_bound(it, end(), DataType::fromSortKey(sortKeyTo),
                        qcpLessThanSortKey<DataType>);
+  mLevels.invalidate(int(it - begin()));
   mData.erase(it, itEnd);
   if (mAutoSqueeze) performAutoSqueeze();
 }
@@ -2483,11 +2584,13 @@ void QCPDataContainer<DataType>::remove(double sortKey) {
       std::lower_bound(begin(), end(), DataType::fromSortKey(sortKey),
                        qcpLessThanSortKey<DataType>);
   if (it != end() && it->sortKey() == sortKey) {
-    if (it == begin())
+    if (it == begin()) {
       ++mPreallocSize;
-
-    else
+      mLevels.removeFront(1);
+    } else {
+      mLevels.invalidate(int(it - begin()));
       mData.erase(it);
+    }
   }
   if (mAutoSqueeze) performAutoSqueeze();
 }
@@ -2497,11 +2600,24 @@ void QCPDataContainer<DataType>::clear() {
   mData.clear();
   mPreallocIteration = 0;
   mPreallocSize = 0;
+  mLevels.reset();
+}
+
+// Makes room for size data points, keeping the memory of earlier ones, for
+// callers that write them through begin() in sorted order.
+template <class DataType>
+void QCPDataContainer<DataType>::resize(int size) {
+  if (mPreallocSize > 0) mData.remove(0, mPreallocSize);
+  mData.resize(size);
+  mPreallocIteration = 0;
+  mPreallocSize = 0;
+  mLevels.reset();
 }
 
 template <class DataType>
 void QCPDataContainer<DataType>::sort() {
   std::sort(begin(), end(), qcpLessThanSortKey<DataType>);
+  mLevels.reset();
 }
 
 template <class DataType>
@@ -3104,6 +3220,7 @@ class QCP_LIB_DECL QCustomPlot : public QWidget {
   Q_PROPERTY(Qt::KeyboardModifier multiSelectModifier READ multiSelectModifier
                  WRITE setMultiSelectModifier)
   Q_PROPERTY(bool openGl READ openGl WRITE setOpenGl)
+  Q_PROPERTY(int renderThreads READ renderThreads WRITE setRenderThreads)
 
  public:
   enum LayerInsertMode { limBelow, limAbove };
@@ -3154,6 +3271,7 @@ class QCP_LIB_DECL QCustomPlot : public QWidget {
   }
   QCPSelectionRect *selectionRect() const { return mSelectionRect; }
   bool openGl() const { return mOpenGl; }
+  int renderThreads() const { return mRenderThreads; }
 
   void setViewport(const QRect &rect);
   void setBufferDevicePixelRatio(double ratio);
@@ -3182,6 +3300,7 @@ class QCP_LIB_DECL QCustomPlot : public QWidget {
   void setSelectionRectMode(QCP::SelectionRectMode mode);
   void setSelectionRect(QCPSelectionRect *selectionRect);
   void setOpenGl(bool enabled, int multisampling = 16);
+  void setRenderThreads(int threads);
 
   QCPAbstractPlottable *plottable(int index);
   QCPAbstractPlottable *plottable();
@@ -3321,6 +3440,7 @@ class QCP_LIB_DECL QCustomPlot : public QWidget {
   QCP::SelectionRectMode mSelectionRectMode;
   QCPSelectionRect *mSelectionRect;
   bool mOpenGl;
+  int mRenderThreads;
 
   QList<QSharedPointer<QCPAbstractPaintBuffer> > mPaintBuffers;
   QPoint mMousePressPos;
@@ -3371,6 +3491,7 @@ class QCP_LIB_DECL QCustomPlot : public QWidget {
   void drawBackground(QCPPainter *painter);
   void setupPaintBuffers();
   QCPAbstractPaintBuffer *createPaintBuffer();
+  void drawPaintBuffers();
   bool hasInvalidatedPaintBuffers();
   bool setupOpenGl();
   void freeOpenGl();
@@ -3881,6 +4002,7 @@ class QCP_LIB_DECL QCPColorGradient {
 
   bool stopsUseAlpha() const;
   void updateColorBuffer();
+  QRgb nanRgb() const;
 };
 Q_DECLARE_METATYPE(QCPColorGradient::ColorInterpolation)
 Q_DECLARE_METATYPE(QCPColorGradient::NanHandling)
@@ -4483,6 +4605,9 @@ class QCP_LIB_DECL QCPGraph : public QCPAbstractPlottable1D<QCPGraphData> {
                  setChannelFillGraph)
   Q_PROPERTY(
       bool adaptiveSampling READ adaptiveSampling WRITE setAdaptiveSampling)
+  Q_PROPERTY(int adaptiveSamplingThreads READ adaptiveSamplingThreads WRITE
+                 setAdaptiveSamplingThreads)
+  Q_PROPERTY(bool levelOfDetail READ levelOfDetail WRITE setLevelOfDetail)
 
  public:
   enum LineStyle {
@@ -4513,6 +4638,8 @@ class QCP_LIB_DECL QCPGraph : public QCPAbstractPlottable1D<QCPGraphData> {
   int scatterSkip() const { return mScatterSkip; }
   QCPGraph *channelFillGraph() const { return mChannelFillGraph.data(); }
   bool adaptiveSampling() const { return mAdaptiveSampling; }
+  int adaptiveSamplingThreads() const { return mAdaptiveSamplingThreads; }
+  bool levelOfDetail() const;
 
   void setData(QSharedPointer<QCPGraphDataContainer> data);
   void setData(const QVector<double> &keys, const QVector<double> &values,
@@ -4522,6 +4649,8 @@ class QCP_LIB_DECL QCPGraph : public QCPAbstractPlottable1D<QCPGraphData> {
   void setScatterSkip(int skip);
   void setChannelFillGraph(QCPGraph *targetGraph);
   void setAdaptiveSampling(bool enabled);
+  void setAdaptiveSamplingThreads(int threads);
+  void setLevelOfDetail(bool enabled);
 
   void addData(const QVector<double> &keys, const QVector<double> &values,
                bool alreadySorted = false);
@@ -4542,6 +4671,7 @@ class QCP_LIB_DECL QCPGraph : public QCPAbstractPlottable1D<QCPGraphData> {
   int mScatterSkip;
   QPointer<QCPGraph> mChannelFillGraph;
   bool mAdaptiveSampling;
+  int mAdaptiveSamplingThreads;
 
   virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
   virtual void drawLegendIcon(QCPPainter *painter,
@@ -4565,6 +4695,7 @@ class QCP_LIB_DECL QCPGraph : public QCPAbstractPlottable1D<QCPGraphData> {
       QCPGraphDataContainer::const_iterator begin,
       QCPGraphDataContainer::const_iterator end) const;
 
+  void updateLevels() const;
   void getVisibleDataBounds(QCPGraphDataContainer::const_iterator &begin,
                             QCPGraphDataContainer::const_iterator &end,
                             const QCPDataRange &rangeRestriction) const;
@@ -4606,6 +4737,116 @@ class QCP_LIB_DECL QCPGraph : public QCPAbstractPlottable1D<QCPGraphData> {
 };
 Q_DECLARE_METATYPE(QCPGraph::LineStyle)
 
+class QCP_LIB_DECL QCPUniformGraphData {
+ public:
+  QCPUniformGraphData();
+
+  int size() const;
+  bool isEmpty() const { return size() == 0; }
+  double keyOrigin() const { return mKeyOrigin; }
+  double keyStep() const { return mKeyStep; }
+  bool singlePrecision() const { return mSinglePrecision; }
+  double key(int index) const { return mKeyOrigin + index * mKeyStep; }
+  double value(int index) const {
+    return mSinglePrecision ? double(mSingleValues.at(index))
+                            : mValues.at(index);
+  }
+
+  void setKeys(double keyOrigin, double keyStep);
+  void setSinglePrecision(bool enabled);
+  void setData(double keyOrigin, double keyStep,
+               const QVector<double> &values);
+  void setValue(int index, double value);
+  void setValues(int index, const double *values, int count);
+  void add(double value);
+  void resize(int size);
+  void clear();
+  void squeeze();
+
+  int findBegin(double key, bool expandedRange = true) const;
+  int findEnd(double key, bool expandedRange = true) const;
+  QCPRange keyRange(bool &foundRange,
+                    QCP::SignDomain signDomain = QCP::sdBoth) const;
+  QCPRange valueRange(bool &foundRange,
+                      QCP::SignDomain signDomain = QCP::sdBoth,
+                      const QCPRange &inKeyRange = QCPRange()) const;
+
+ protected:
+  double mKeyOrigin, mKeyStep;
+  bool mSinglePrecision;
+  QVector<double> mValues;
+  QVector<float> mSingleValues;
+
+  friend class QCPUniformGraph;
+};
+
+class QCP_LIB_DECL QCPUniformGraph : public QCPAbstractPlottable,
+                                     public QCPPlottableInterface1D {
+  Q_OBJECT
+
+  Q_PROPERTY(
+      bool adaptiveSampling READ adaptiveSampling WRITE setAdaptiveSampling)
+  Q_PROPERTY(int adaptiveSamplingThreads READ adaptiveSamplingThreads WRITE
+                 setAdaptiveSamplingThreads)
+
+ public:
+  explicit QCPUniformGraph(QCPAxis *keyAxis, QCPAxis *valueAxis);
+  virtual ~QCPUniformGraph() Q_DECL_OVERRIDE;
+
+  QSharedPointer<QCPUniformGraphData> data() const { return mData; }
+  bool adaptiveSampling() const { return mAdaptiveSampling; }
+  int adaptiveSamplingThreads() const { return mAdaptiveSamplingThreads; }
+
+  void setData(QSharedPointer<QCPUniformGraphData> data);
+  void setData(double keyOrigin, double keyStep,
+               const QVector<double> &values);
+  void setAdaptiveSampling(bool enabled);
+  void setAdaptiveSamplingThreads(int threads);
+
+  virtual int dataCount() const Q_DECL_OVERRIDE;
+  virtual double dataMainKey(int index) const Q_DECL_OVERRIDE;
+  virtual double dataSortKey(int index) const Q_DECL_OVERRIDE;
+  virtual double dataMainValue(int index) const Q_DECL_OVERRIDE;
+  virtual QCPRange dataValueRange(int index) const Q_DECL_OVERRIDE;
+  virtual QPointF dataPixelPosition(int index) const Q_DECL_OVERRIDE;
+  virtual bool sortKeyIsMainKey() const Q_DECL_OVERRIDE { return true; }
+  virtual QCPDataSelection selectTestRect(
+      const QRectF &rect, bool onlySelectable) const Q_DECL_OVERRIDE;
+  virtual int findBegin(double sortKey,
+                        bool expandedRange = true) const Q_DECL_OVERRIDE;
+  virtual int findEnd(double sortKey,
+                      bool expandedRange = true) const Q_DECL_OVERRIDE;
+
+  virtual double selectTest(const QPointF &pos, bool onlySelectable,
+                            QVariant *details = nullptr) const Q_DECL_OVERRIDE;
+  virtual QCPPlottableInterface1D *interface1D() Q_DECL_OVERRIDE {
+    return this;
+  }
+  virtual QCPRange getKeyRange(bool &foundRange,
+                               QCP::SignDomain inSignDomain = QCP::sdBoth) const
+      Q_DECL_OVERRIDE;
+  virtual QCPRange getValueRange(
+      bool &foundRange, QCP::SignDomain inSignDomain = QCP::sdBoth,
+      const QCPRange &inKeyRange = QCPRange()) const Q_DECL_OVERRIDE;
+
+ protected:
+  QSharedPointer<QCPUniformGraphData> mData;
+  bool mAdaptiveSampling;
+  int mAdaptiveSamplingThreads;
+
+  virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
+  virtual void drawLegendIcon(QCPPainter *painter,
+                              const QRectF &rect) const Q_DECL_OVERRIDE;
+
+  void drawLinePlot(QCPPainter *painter, const QVector<QPointF> &lines) const;
+  void getDataSegments(QList<QCPDataRange> &selectedSegments,
+                       QList<QCPDataRange> &unselectedSegments) const;
+  void getLines(QVector<QPointF> *lines, const QCPDataRange &dataRange) const;
+
+ private:
+  Q_DISABLE_COPY(QCPUniformGraph)
+};
+
 class QCP_LIB_DECL QCPCurveData {
  public:
   QCPCurveData();
@@ -5050,8 +5291,10 @@ class QCP_LIB_DECL QCPColorMapData {
   unsigned char *mAlpha;
   QCPRange mDataBounds;
   bool mDataModified;
+  int mModifiedBegin, mModifiedEnd;
 
   bool createAlpha(bool initializeOpaque = true);
+  void markModified(int valueIndexBegin, int valueIndexEnd);
 
   friend class QCPColorMap;
 };
@@ -5068,6 +5311,7 @@ class QCP_LIB_DECL QCPColorMap : public QCPAbstractPlottable {
   Q_PROPERTY(bool interpolate READ interpolate WRITE setInterpolate)
   Q_PROPERTY(bool tightBoundary READ tightBoundary WRITE setTightBoundary)
   Q_PROPERTY(QCPColorScale *colorScale READ colorScale WRITE setColorScale)
+  Q_PROPERTY(int imageThreads READ imageThreads WRITE setImageThreads)
 
  public:
   explicit QCPColorMap(QCPAxis *keyAxis, QCPAxis *valueAxis);
@@ -5080,6 +5324,7 @@ class QCP_LIB_DECL QCPColorMap : public QCPAbstractPlottable {
   bool tightBoundary() const { return mTightBoundary; }
   QCPColorGradient gradient() const { return mGradient; }
   QCPColorScale *colorScale() const { return mColorScale.data(); }
+  int imageThreads() const { return mImageThreads; }
 
   void setData(QCPColorMapData *data, bool copy = false);
   Q_SLOT void setDataRange(const QCPRange &dataRange);
@@ -5088,6 +5333,7 @@ class QCP_LIB_DECL QCPColorMap : public QCPAbstractPlottable {
   void setInterpolate(bool enabled);
   void setTightBoundary(bool enabled);
   void setColorScale(QCPColorScale *colorScale);
+  void setImageThreads(int threads);
 
   void rescaleDataRange(bool recalculateDataBounds = false);
   Q_SLOT void updateLegendIcon(
@@ -5116,6 +5362,7 @@ class QCP_LIB_DECL QCPColorMap : public QCPAbstractPlottable {
   bool mInterpolate;
   bool mTightBoundary;
   QPointer<QCPColorScale> mColorScale;
+  int mImageThreads;
 
   QImage mMapImage, mUndersampledMapImage;
   QPixmap mLegendIcon;